@@ -0,0 +1,115 @@
+//         Copyright Ciriaco Garcia de Celis 2016.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <fcntl.h>
+#include <cstdlib>
+#include <iostream>
+#include "Application.h"
+
+#define ROUND_TRIPS   100000 // awaited one after another
+#define SESSIONS      1000 // concurrent coroutines
+#define SESSION_TRIPS 100 // each one
+
+int main()
+{
+    return Application::run();
+}
+
+template <typename Duration> static double elapsed(Duration lapse)
+{
+    return std::chrono::duration<double>(lapse).count();
+}
+
+Client::Coro Client::onMessage(Start&) // (the handler returns on the first co_await)
+{
+    server = Server::create();
+
+    auto tStart = std::chrono::steady_clock::now();
+    for (int i = 0; i < ROUND_TRIPS; i++)
+    {
+        auto pong = co_await ask<Pong>(server, Ping { i });
+        if (!pong || (pong->seq != i)) errors++;
+    }
+    std::cout << 1e9 * elapsed(std::chrono::steady_clock::now() - tStart) / ROUND_TRIPS
+              << " nsec per ask() round trip awaited by a coroutine" << std::endl;
+
+    auto allEnded = expect<SessionsEnd>(); // completed by the last session
+    sessionsEnd = allEnded.path();
+    tStart = std::chrono::steady_clock::now();
+    for (sessions = 0; sessions < SESSIONS;) session(SESSION_TRIPS);
+    co_await allEnded;
+    std::cout << 1e9 * elapsed(std::chrono::steady_clock::now() - tStart) / (SESSIONS * SESSION_TRIPS)
+              << " nsec per ask() round trip with " << SESSIONS << " coroutines in flight (frames recycled)"
+              << std::endl;
+
+    tStart = std::chrono::steady_clock::now();
+    co_await sleepFor(std::chrono::milliseconds(20));
+    std::cout << "sleepFor(20 msec) resumed after " << 1e3 * elapsed(std::chrono::steady_clock::now() - tStart)
+              << " msec" << std::endl;
+
+    auto early = ask<Pong>(server, Ping { -1 }); // answered while sleeping (kept until awaited)
+    co_await sleepFor(std::chrono::milliseconds(20));
+    auto late = co_await early;
+    if (!late || (late->seq != -1)) errors++;
+    std::cout << "ask() answered before its co_await " << (late? "resumed with the reply" : "LOST") << std::endl;
+
+    tStart = std::chrono::steady_clock::now();
+    auto none = co_await ask<Pong>(server, Ignored{}).timeout(std::chrono::milliseconds(20), nullptr);
+    if (none) errors++;
+    std::cout << "unanswered ask() resumed by its timeout after "
+              << 1e3 * elapsed(std::chrono::steady_clock::now() - tStart) << " msec" << std::endl;
+
+    char name[] = "/var/tmp/actor_coroutines_XXXXXX";
+    int fd = mkstemp(name);
+    std::string text = "written and read back through ActorIO from a coroutine";
+    auto written = expect<ActorIO::Completion>();
+    if ((fd < 0) || !io->write(written.path(), fd, std::vector<char>(text.begin(), text.end()), 0)) errors++;
+    else
+    {
+        auto wrote = co_await written;
+        auto read = expect<ActorIO::Completion>();
+        io->read(read.path(), fd, text.size(), 0);
+        auto got = co_await read;
+        bool same = wrote && got && (got->data == std::vector<char>(text.begin(), text.end()));
+        if (!same) errors++;
+        std::cout << "file " << (same? "" : "NOT ") << text << (io->uring()? " (io_uring)" : " (threads)")
+                  << std::endl;
+    }
+    if (fd >= 0)
+    {
+        close(fd);
+        unlink(name);
+    }
+
+    server.reset();
+    auto owner = app.lock();
+    if (owner) owner->send(Done { errors });
+}
+
+Client::Coro Client::session(int rounds) // (the frame holds the state of every session)
+{
+    sessions++;
+    for (int i = 0; i < rounds; i++)
+    {
+        auto pong = co_await ask<Pong>(server, Ping { i });
+        if (!pong || (pong->seq != i)) errors++;
+    }
+    if (!--sessions) reply(sessionsEnd, SessionsEnd{});
+}
+
+void Application::onStart()
+{
+    io = ActorIO::create();
+    client = Client::create(io, std::static_pointer_cast<Application>(weak_from_this().lock()));
+    client->send(Start{});
+}
+
+void Application::onMessage(Done& done)
+{
+    std::cout << (done.errors? "FAILED" : "OK") << std::endl;
+    client.reset();
+    io.reset();
+    stop(done.errors? EXIT_FAILURE : EXIT_SUCCESS);
+}
@@ -0,0 +1,57 @@
+//         Copyright Ciriaco Garcia de Celis 2016.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef APPLICATION_H
+#define APPLICATION_H
+
+#include <string>
+#include <chrono>
+#include <sys++/ActorIO.hpp>
+
+struct Ping { int seq; };
+struct Pong { int seq; };
+struct Ignored {}; // never answered
+struct Start {};
+struct SessionsEnd {};
+struct Done { int errors; };
+
+class Server : public ActorThread<Server>
+{
+    friend ActorThread<Server>;
+
+    void onMessage(Ping& ping) { reply(Pong { ping.seq }); }
+    void onMessage(Ignored&) {}
+};
+
+class Client : public ActorThread<Client> // a multi-step workflow written as coroutines (no state machine)
+{
+    friend ActorThread<Client>;
+
+    Client(std::shared_ptr<ActorIO> service, std::weak_ptr<class Application> owner)
+      : io(service), app(owner), sessions(0), errors(0) {}
+
+    Coro onMessage(Start&);
+    Coro session(int rounds);
+
+    std::shared_ptr<ActorIO> io;
+    std::weak_ptr<class Application> app;
+    Server::ptr server;
+    int sessions; // in progress
+    std::shared_ptr<ActorAsk> sessionsEnd; // see expect()
+    int errors;
+};
+
+class Application : public ActorThread<Application>
+{
+    friend ActorThread<Application>;
+
+    void onStart();
+    void onMessage(Done&);
+
+    std::shared_ptr<ActorIO> io;
+    Client::ptr client;
+};
+
+#endif /* APPLICATION_H */
@@ -28,6 +28,10 @@ void Application::onStart()
     world->send(Gallery { "La persistencia de la memoria", "Dali" });
     world->send(Bank { 50, "savings" });
 
+    ask<Forecast>(world, Weather { "Madrid" }) // request / reply with a continuation (and an optional timeout)
+        .then([this](Forecast& msg) { printer->send(LINE("<application> is answered: " << msg.sky)); })
+        .timeout(std::chrono::milliseconds(500), [this] { printer->send(LINE("<application> got no answer")); });
+
     timerStart(123, std::chrono::seconds(1));
 }
 
@@ -53,6 +57,10 @@ void Application::onTimer(const int&)
 
 void Application::onStop()
 {
+    for (auto& stats : printer->metrics().messages)
+        printer->send(LINE("<application> printer metrics: " << stats.delivered << " lines, median wait "
+                           << stats.dwell.percentile(0.5) << " ns, median handling "
+                           << stats.handling.percentile(0.5) << " ns"));
     printer->send(LINE("<application> exiting"));
     printer->waitIdle();
     world.reset();
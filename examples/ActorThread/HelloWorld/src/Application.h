@@ -14,6 +14,7 @@
 struct Newspaper { std::string name; };
 struct Picture   { int width, height; };
 struct Money     { double amount; };
+struct Forecast  { std::string sky; };
 
 class Application : public ActorThread<Application>
 {
@@ -39,6 +39,8 @@ class Printer : public ActorThread<Printer> // a dedicated printing thread preve
     }
 
     std::chrono::system_clock::time_point start;
+
+    static const bool instrumented = true; // collect metrics() (see Application::onStop())
 };
 
 #endif /* PRINTER_H */
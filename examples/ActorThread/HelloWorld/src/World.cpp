@@ -36,3 +36,9 @@ void World::onMessage(Bank& msg)
     printer->send(LINE("<world> is requested: " << msg.amount << " euros from " << msg.account));
     app->send(Money { msg.amount });
 }
+
+void World::onMessage(Weather& msg)
+{
+    printer->send(LINE("<world> is asked: weather in " << msg.city));
+    reply(Forecast { "sunny" }); // back to the asking object
+}
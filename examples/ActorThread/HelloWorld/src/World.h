@@ -14,6 +14,7 @@
 struct Kiosk   { std::string itemRequest; };
 struct Gallery { std::string pictureName; std::string author; };
 struct Bank    { double amount; std::string account; };
+struct Weather { std::string city; }; // request (see Application::onStart())
 
 class World : public ActorThread<World>
 {
@@ -26,6 +27,7 @@ class World : public ActorThread<World>
     void onMessage(Kiosk&);
     void onMessage(Gallery&);
     void onMessage(Bank&);
+    void onMessage(Weather&);
 
     Printer::ptr printer;
     std::shared_ptr<class Application> app; // equivalent to ActorThread<class Application>::ptr
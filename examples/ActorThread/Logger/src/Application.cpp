@@ -0,0 +1,120 @@
+
+//         Copyright Ciriaco Garcia de Celis 2016.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <fcntl.h>
+#include <cstdlib>
+#include <iostream>
+#include "Application.h"
+
+#define LOG_BURSTS  20
+#define BURST_LINES 1000 // sent every millisecond (along with a dispatcher latency probe)
+#define SYNC_EVERY  500 // lines
+
+int main()
+{
+    return Application::run();
+}
+
+Logger::~Logger()
+{
+    if (fd < 0) return;
+    close(fd);
+    unlink(path.c_str());
+}
+
+void Logger::onStart()
+{
+    char name[] = "/var/tmp/actor_logger_XXXXXX";
+    fd = mkstemp(name);
+    path = name;
+    self = getLink<ActorIO::Completion>();
+}
+
+void Logger::onMessage(LogLine& line)
+{
+    std::vector<char> data(line.text.begin(), line.text.end());
+    data.push_back('\n');
+    auto size = static_cast<int64_t>(data.size());
+    if (!io) errors += pwrite(fd, data.data(), data.size(), offset) != size;
+    else if (io->write(self, fd, std::move(data), offset)) pending++;
+    else errors++;
+    offset += size;
+    if (++lines % SYNC_EVERY == 0) sync();
+}
+
+void Logger::sync()
+{
+    if (!io) errors += ::fsync(fd) < 0;
+    else if (io->fsync(self, fd)) pending++; // (after the writes already submitted)
+    else errors++;
+}
+
+void Logger::onMessage(ActorIO::Completion& done)
+{
+    if (done.result < 0) errors++;
+    if (!--pending && flushing) flushed();
+}
+
+void Logger::onMessage(Flush&)
+{
+    flushing = true;
+    sync();
+    if (!pending) flushed();
+}
+
+void Logger::onMessage(Ping&)
+{
+    reply(Pong{});
+}
+
+void Logger::flushed()
+{
+    if (lseek(fd, 0, SEEK_END) != offset) errors++; // (whatever the writes completion order)
+    auto owner = app.lock();
+    if (owner) owner->send(Flushed { lines, errors });
+}
+
+void Application::onStart()
+{
+    startRound();
+}
+
+void Application::startRound() // blocking calls, io_uring and the threads fallback
+{
+    io = round == 0? std::shared_ptr<ActorIO>() : ActorIO::create(256, 2, round == 1);
+    logger = Logger::create(io, std::static_pointer_cast<Application>(weak_from_this().lock()));
+    maxPing = 0;
+    bursts = 0;
+    tStart = std::chrono::steady_clock::now();
+    timerStart('B', std::chrono::milliseconds(1), TimerCycle::Periodic);
+}
+
+void Application::onTimer(const char&)
+{
+    auto sent = std::chrono::steady_clock::now();
+    ask<Pong>(logger, Ping{}).then([this, sent](Pong&) // how long the logger takes to attend its mailbox
+    {
+        auto latency = std::chrono::duration<double>(std::chrono::steady_clock::now() - sent).count();
+        if (latency > maxPing) maxPing = latency;
+    });
+    for (int i = 1; i <= BURST_LINES; i++)
+        logger->send(LogLine { "line " + std::to_string(bursts * BURST_LINES + i) + " of the log (through an actor)" });
+    if (++bursts < LOG_BURSTS) return;
+    timerStop('B');
+    logger->send(Flush{});
+}
+
+void Application::onMessage(Flushed& result)
+{
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - tStart).count();
+    const char* method = !io? "blocking write() / fsync()" : io->uring()? "io_uring" : "threads fallback";
+    std::cout << result.lines << " lines logged and synced in " << elapsed << " seconds through "
+              << method << " (" << result.errors << " errors, worst ping " << 1e3 * maxPing << " msec)" << std::endl;
+    logger.reset();
+    io.reset();
+    if (++round < 3) startRound();
+    else stop();
+}
@@ -0,0 +1,67 @@
+
+//         Copyright Ciriaco Garcia de Celis 2016.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef APPLICATION_H
+#define APPLICATION_H
+
+#include <string>
+#include <chrono>
+#include <sys++/ActorIO.hpp>
+
+struct LogLine { std::string text; };
+struct Flush {};
+struct Flushed { int lines; int errors; };
+struct Ping {};
+struct Pong {};
+
+class Logger : public ActorThread<Logger> // appends the lines to a file (synced to disk periodically)
+{
+    friend ActorThread<Logger>;
+
+    Logger(std::shared_ptr<ActorIO> service, std::weak_ptr<class Application> owner) // blocking calls if no service
+      : io(service), app(owner), fd(-1), offset(0), lines(0), pending(0), errors(0), flushing(false) {}
+    ~Logger();
+
+    void onStart();
+    void onMessage(LogLine&);
+    void onMessage(Flush&);
+    void onMessage(ActorIO::Completion&);
+    void onMessage(Ping&);
+    void sync();
+    void flushed();
+
+    std::shared_ptr<ActorIO> io;
+    ActorIO::Requester self; // where the completions are delivered
+    std::weak_ptr<class Application> app;
+    std::string path;
+    int fd;
+    int64_t offset;
+    int lines;
+    int pending; // operations in progress
+    int errors;
+    bool flushing;
+};
+
+class Application : public ActorThread<Application> // compares the logger dispatcher stalls with each I/O method
+{
+    friend ActorThread<Application>;
+
+    Application() : round(0) {}
+
+    void onStart();
+    void onMessage(Flushed&);
+    void onTimer(const char&);
+    void startRound();
+
+    Logger::ptr logger;
+    std::shared_ptr<ActorIO> io;
+    int round;
+    int bursts;
+    std::chrono::steady_clock::time_point tStart;
+    double maxPing;
+};
+
+#endif /* APPLICATION_H */
@@ -0,0 +1,110 @@
+
+//         Copyright Ciriaco Garcia de Celis 2016.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#include <sys/socket.h>
+#include <cctype>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include "Application.h"
+
+#define ROUND_TRIPS 100000
+#define STATS_EVERY 25000 // echoes
+
+int main()
+{
+    return Application::run();
+}
+
+Echo::~Echo()
+{
+    close(fd);
+}
+
+void Echo::onStart()
+{
+    fdWatch(fd);
+}
+
+void Echo::onReadable(int socket)
+{
+    char line[64];
+    auto size = recv(socket, line, sizeof(line), 0);
+    if (size <= 0) // peer closed
+    {
+        fdUnwatch(socket);
+        return;
+    }
+    for (ssize_t i = 0; i < size; i++) line[i] = static_cast<char>(std::toupper(line[i]));
+    ::send(socket, line, static_cast<std::size_t>(size), 0);
+    if (++echoes % STATS_EVERY == 0)
+    {
+        auto owner = app.lock();
+        if (owner) owner->send(EchoStats { echoes }); // through the mailbox (the same epoll_wait() on the other side)
+    }
+}
+
+Application::~Application()
+{
+    if (fd >= 0) close(fd);
+}
+
+void Application::onStart()
+{
+    int pair[2];
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0, pair) < 0)
+    {
+        std::perror("socketpair");
+        stop(1);
+        return;
+    }
+    fd = pair[0];
+    echo = Echo::create(pair[1], std::static_pointer_cast<Application>(weak_from_this().lock()));
+    fdWatch(fd);
+    timerStart('W', std::chrono::seconds(30)); // watchdog
+    tStart = std::chrono::steady_clock::now();
+    ping();
+}
+
+void Application::ping()
+{
+    char line[32];
+    auto size = std::snprintf(line, sizeof(line), "ping %d", roundTrips);
+    ::send(fd, line, static_cast<std::size_t>(size), 0);
+}
+
+void Application::onReadable(int socket)
+{
+    char line[64];
+    auto size = recv(socket, line, sizeof(line) - 1, 0);
+    if (size <= 0) return;
+    line[size] = 0;
+    if (std::strncmp(line, "PING ", 5))
+    {
+        std::cout << "unexpected echo: " << line << std::endl;
+        stop(1);
+    }
+    else if (++roundTrips < ROUND_TRIPS) ping();
+    else
+    {
+        auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - tStart).count();
+        std::cout << roundTrips << " socket round trips in " << elapsed << " seconds ("
+                  << 1e6 * elapsed / roundTrips << " usec each)" << std::endl;
+        echo.reset(); // (stops its epoll loop)
+        stop();
+    }
+}
+
+void Application::onMessage(EchoStats& stats)
+{
+    std::cout << "echo server: " << stats.echoes << " datagrams echoed" << std::endl;
+}
+
+void Application::onTimer(const char&)
+{
+    std::cout << "timeout: only " << roundTrips << " round trips" << std::endl;
+    stop(1);
+}
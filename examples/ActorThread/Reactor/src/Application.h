@@ -0,0 +1,51 @@
+
+//         Copyright Ciriaco Garcia de Celis 2016.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+
+#ifndef APPLICATION_H
+#define APPLICATION_H
+
+#include <chrono>
+#include <sys++/ActorReactor.hpp>
+
+struct EchoStats { int echoes; };
+
+class Echo : public ActorReactor<Echo> // upper-cases every datagram received on its socket (without Asio)
+{
+    friend ActorThread<Echo>;
+    friend ActorReactor<Echo>;
+
+    Echo(int socket, std::weak_ptr<class Application> owner) : fd(socket), app(owner), echoes(0) {}
+    ~Echo();
+
+    void onStart();
+    void onReadable(int);
+
+    int fd;
+    std::weak_ptr<class Application> app;
+    int echoes;
+};
+
+class Application : public ActorReactor<Application> // waits for its messages, timers and socket at once
+{
+    friend ActorThread<Application>;
+    friend ActorReactor<Application>;
+
+    Application() : fd(-1), roundTrips(0) {}
+    ~Application();
+
+    void onStart();
+    void onReadable(int);
+    void onMessage(EchoStats&);
+    void onTimer(const char&);
+    void ping();
+
+    int fd;
+    Echo::ptr echo;
+    int roundTrips;
+    std::chrono::steady_clock::time_point tStart;
+};
+
+#endif /* APPLICATION_H */
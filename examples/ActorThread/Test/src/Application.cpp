@@ -8,13 +8,45 @@
 #include <iostream>
 #include <chrono>
 #include <cstdlib>
+#include <cmath>
+#include <cstring>
 #include <algorithm>
+#include <fstream>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
 #include "Application.h"
 
 #define DURATION_SYNC  std::chrono::seconds(4)
 #define DURATION_ASYNC std::chrono::milliseconds(250) // uses a lot of memory
 #define DURATION_MIXED std::chrono::seconds(3)
 #define DURATION_MPSC  std::chrono::seconds(2)
+#define DURATION_NP1C  std::chrono::milliseconds(250) // per amount of producers (uses a lot of memory)
+
+#define MPSC_FIRST_ID 3 // of the NP1C scaling producers (1 and 2 are used by the 2P1C test)
+
+#define DURATION_PLACEMENT std::chrono::milliseconds(250) // per placement (uses a lot of memory)
+
+#define MIXED_CAPACITY 2000 // pending messages
+
+#define FANOUT_DELIVERIES 1000000 // per round (split among the subscribers)
+
+#define POLICY_PERIOD std::chrono::milliseconds(1) // of the timer and the probes of the dispatch policy test
+#define POLICY_PROBES 250 // (uses a lot of memory)
+
+#define SAMPLES 1000000 // per round of the batch delivery test
+#define SAMPLES_BURST 1024 // (also the longest run)
+
+#define IDLE_ACTORS 500 // of the hibernation test
+#define HIBERNATION std::chrono::milliseconds(50) // idle time until releasing their thread
+#define IDLE_SETTLE std::chrono::milliseconds(400) // until hibernated (and their recycled threads ended)
+
+#define PIPELINE_STAGES 4 // buffers test (the packets are copied or sliced between each two)
+#define PIPELINE_CAPACITY 256 // pending packets of each stage
+#define PIPELINE_HEADER 16 // bytes removed by each intermediate stage
+
+#define SPIN_LOOPS  2000 // idle strategy of the second synchronous test
+#define YIELD_LOOPS 100
 
 int main(int argc, char **argv)
 {
@@ -43,12 +75,24 @@ template <> void Task::onMessage(SyncMsg& msg) // sends one message after receiv
         app->send(SyncEnd{ msg.counter });
 }
 
-template <> void Task::onMessage(AsyncBegin&)
+template <> void Task::onMessage(Pooling& msg)
+{
+    pooledMessages(msg.enable); // affects the messages sent to this thread
+}
+
+template <> void Task::onMessage(AsyncBegin& msg)
 {
     auto deadline = std::chrono::steady_clock::now() + DURATION_ASYNC;
     int counter = 0;
+    std::vector<AsyncMsg> batch(msg.batched? 10000 : 0);
     while (std::chrono::steady_clock::now() < deadline)
-        for (auto cnt = 0; cnt < 10000; cnt++) sibling->send(AsyncMsg { ++counter, false });
+        if (msg.batched)
+        {
+            for (auto& item : batch) item = AsyncMsg { ++counter, false };
+            sibling->sendBatch(batch.begin(), batch.end()); // single enqueue and (at most) a single wakeup
+        }
+        else
+            for (auto cnt = 0; cnt < 10000; cnt++) sibling->send(AsyncMsg { ++counter, false });
     sibling->send(AsyncMsg { ++counter, true });
 }
 
@@ -57,17 +101,12 @@ template <> void Task::onMessage(AsyncMsg& msg)
     if (msg.last) app->send(AsyncEnd { msg.counter }); // both threads notify the completion when receiving the last message
 }
 
-void Task::doMixed()
+void Task::doMixed() // the sibling mailbox is bounded (Overflow::Fail) so send() refuses to overflow it
 {
-    auto pending = sibling->pendingMessages();
-    if (mixedTestPaused && (pending < 1000)) mixedTestPaused = false;
-    if (!mixedTestPaused && (pending > 2000)) mixedTestPaused = true;
-    if (mixedTestPaused) return;
-
     if (rnd(gen) < 5)
-        for (auto i = rnd(gen); i >= 0; i--) { sibling->send(A{}); fstats.sntA++; }
+        for (auto i = rnd(gen); (i >= 0) && sibling->send(A{}); i--) fstats.sntA++;
     else
-        for (auto i = rnd(gen); i >= 0; i--) { sibling->send(B{}); fstats.sntB++; }
+        for (auto i = rnd(gen); (i >= 0) && sibling->send(B{}); i--) fstats.sntB++;
 }
 
 template <> void Task::onMessage(MixedBegin&)
@@ -105,13 +144,36 @@ template <> void Task::onMessage(MpscEnd& msg)
     app->send(Mpsc { msg.id, -1 }); // acknowledge the end
 }
 
+template <> void Task::onMessage(PlacementBegin& msg)
+{
+    sink = msg.sink;
+    while (pendingMessages() < 2) sink->send(Placed { ++placed }); // while PlacementEnd not yet received
+}
+
+template <> void Task::onMessage(Placed&)
+{
+    if (!placed++) firstPlaced = std::chrono::steady_clock::now();
+}
+
+template <> void Task::onMessage(PlacementEnd& msg)
+{
+    if (sink) // producer: behind the flood
+    {
+        sink->send(PlacementEnd { placed });
+        sink.reset();
+        return;
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - firstPlaced).count();
+    app->send(PlacementStats { msg.produced, placed, elapsed });
+}
+
 template <> void Task::onMessage(BreedExplode& msg)
 {
     if (msg.generation <= msg.maxGenerations)
     {
         for (auto i = 0; i < msg.amount; i++)
         {
-            auto child = Task::create(weak_from_this().lock());
+            auto child = Task::create(settings(), weak_from_this().lock()); // (same threading model)
             child->send(BreedExplode { msg.amount, msg.generation+1, msg.maxGenerations });
             pendingChilds.insert(child); // keeps the child thread referenced (and alive)
         }
@@ -157,18 +219,115 @@ template <> void Task::onMessage(BreedImplode& msg)
     }
 }
 
+template <> void Task::onMessage(TimersBegin& msg) // rates with that many live timers
+{
+    auto seconds = [](std::chrono::steady_clock::time_point since)
+    {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - since).count();
+    };
+    timersBench.amount = msg.amount;
+    auto tStart = std::chrono::steady_clock::now();
+    for (int i = 0; i < msg.amount; i++) timerStart(i, std::chrono::hours(1));
+    timersBench.started = msg.amount / seconds(tStart);
+    tStart = std::chrono::steady_clock::now();
+    for (int i = 0; i < msg.amount; i++) timerReset(i);
+    timersBench.reset = msg.amount / seconds(tStart);
+    tStart = std::chrono::steady_clock::now();
+    for (int i = 0; i < msg.amount; i++) timerStop(i);
+    timersBench.stopped = msg.amount / seconds(tStart);
+    timersFired = 0;
+    for (int i = 0; i < msg.amount; i++) timerStart(i, std::chrono::milliseconds(0)); // all of them due at once
+}
+
+template <> void Task::onTimer(const int&)
+{
+    if (timersFired++ == 0) firstFire = std::chrono::steady_clock::now();
+    else if (timersFired == timersBench.amount)
+    {
+        timersBench.fired = (timersFired - 1) / std::chrono::duration<double>(std::chrono::steady_clock::now()
+                                                                             - firstFire).count();
+        app->send(timersBench);
+    }
+}
+
 template <> void Task::onTimer(const char& timer)
 {
     if (timer == 'S') syncTestCompleted = true;
     else
     {
-        sibling->send(MixedEnd{});
+        sibling->send<true>(MixedEnd{}); // (high priority messages are never refused by a bounded mailbox)
         mixedTestCompleted = true;
     }
 }
 
+template <> void Task::onMessage(FanoutBegin& msg) // a single payload allocation per update
+{
+    auto tStart = std::chrono::steady_clock::now();
+    for (int i = 0; i < msg.updates; i++) broadcast(Quote { i, 100.0 + rnd(gen), 100.5 + rnd(gen), i + 1 == msg.updates });
+    app->send(FanoutEnd { std::chrono::duration<double>(std::chrono::steady_clock::now() - tStart).count() });
+}
+
+template <> void Task::onMessage(std::shared_ptr<const Quote>& quote)
+{
+    if (quote->last) app->send(FanoutEnd { -1.0 }); // (only the publisher reports a duration)
+}
+
+template <> void Task::onMessage(PolicyBegin&) // a periodic timer and normal priority probes under a flood
+{
+    policyStats = PolicyStats { 0, 0, 0, 0, 0, 0 };
+    floodsEnded = 0;
+    timerStart(true, POLICY_PERIOD, TimerCycle::Periodic);
+}
+
+template <> void Task::onMessage(FloodBegin& msg) // pendingMessages() == 1 at the beginning (just this one)
+{
+    while (pendingMessages() < 2) msg.target->send<true>(Flood{}); // while FloodStop not yet received from parent
+    msg.target->send<true>(FloodEnd{}); // (behind all of its Flood messages)
+}
+
+template <> void Task::onMessage(FloodStop&) {}
+
+template <> void Task::onMessage(Flood&) {}
+
+template <> void Task::onMessage(FloodEnd&)
+{
+    if (++floodsEnded == 2) send(PolicyEnd{}); // (behind all of the probes)
+}
+
+template <> void Task::onMessage(Probe& msg)
+{
+    auto latency = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - msg.sent).count();
+    policyStats.probes++;
+    policyStats.latencySum += latency;
+    policyStats.latencyMax = std::max(policyStats.latencyMax, latency);
+}
+
+template <> void Task::onMessage(PolicyEnd&)
+{
+    timerStop(true);
+    app->send(policyStats);
+}
+
+template <> void Task::onTimer(const bool&)
+{
+    auto now = std::chrono::steady_clock::now();
+    if (policyStats.ticks++)
+    {
+        auto jitter = std::chrono::duration<double, std::micro>(now - lastTick - POLICY_PERIOD).count();
+        policyStats.jitterSum += std::abs(jitter);
+        policyStats.jitterMax = std::max(policyStats.jitterMax, std::abs(jitter));
+    }
+    lastTick = now;
+}
+
 void Application::onStart()
 {
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::string(argv[i]) == "--placement") placement = true;
+        else generations = std::max(std::atoi(argv[i]), 1);
+    }
+
     std::cout << "testing performance..." << std::endl;
 
     snd1 = Task::create(weak_from_this().lock());
@@ -176,6 +335,14 @@ void Application::onStart()
     snd1->send(snd2);
     snd2->send(snd1);
 
+    Task::Settings bounded;
+    bounded.capacity = MIXED_CAPACITY;
+    bounded.overflow = Task::Overflow::Fail;
+    mix1 = Task::create(bounded, weak_from_this().lock());
+    mix2 = Task::create(bounded, weak_from_this().lock());
+    mix1->send(mix2);
+    mix2->send(mix1);
+
     tStart = std::chrono::steady_clock::now();
     snd1->send(SyncBegin{ true });
     snd2->send(SyncBegin{ false });
@@ -184,25 +351,54 @@ void Application::onStart()
 template <> void Application::onMessage(SyncEnd& msg)
 {
     auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - tStart).count();
-    std::cout << msg.counter / elapsed << " synchronous messages per second" << std::endl;
+    std::cout << msg.counter / elapsed << " synchronous messages per second (ping-pong round trip latency "
+              << 2e6 * elapsed / msg.counter << " usec" << (spin1? " spinning before parking)" : ")") << std::endl;
+
+    if (!spin1) // repeat with an idle strategy avoiding the sleep / wakeup system calls (when fast enough)
+    {
+        Task::Settings spinning;
+        spinning.spinLoops = SPIN_LOOPS;
+        spinning.yieldLoops = YIELD_LOOPS;
+        spin1 = Task::create(spinning, weak_from_this().lock());
+        spin2 = Task::create(spinning, weak_from_this().lock());
+        spin1->send(spin2);
+        spin2->send(spin1);
+        tStart = std::chrono::steady_clock::now();
+        spin1->send(SyncBegin{ true });
+        spin2->send(SyncBegin{ false });
+        return;
+    }
 
     repliesCount = 0;
     tStart = std::chrono::steady_clock::now();
-    snd1->send(AsyncBegin{});
-    snd2->send(AsyncBegin{});
+    snd1->send(AsyncBegin{ false });
+    snd2->send(AsyncBegin{ false });
 }
 
 template <> void Application::onMessage(AsyncEnd& msg)
 {
     auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - tStart).count();
-    std::cout << msg.counter / elapsed << " asynchronous messages per second and thread" << std::endl;
+    std::cout << msg.counter / elapsed << " asynchronous messages per second and thread" << label() << std::endl;
     repliesCount++;
     if (repliesCount == 2)
     {
         repliesCount = 0;
+        if (pooledRun) { pooledRun = false; batchedRun = true; } // then repeat using sendBatch()
+        else if (batchedRun) batchedRun = false;
+        else pooledRun = true; // repeat the test with pooled messages memory
+        snd1->send(Pooling { pooledRun });
+        snd2->send(Pooling { pooledRun });
         tStart = std::chrono::steady_clock::now();
-        snd1->send(MixedBegin{});
-        snd2->send(MixedBegin{});
+        if (pooledRun || batchedRun)
+        {
+            snd1->send(AsyncBegin{ batchedRun });
+            snd2->send(AsyncBegin{ batchedRun });
+        }
+        else
+        {
+            mix1->send(MixedBegin{});
+            mix2->send(MixedBegin{});
+        }
     }
 }
 
@@ -213,19 +409,34 @@ template <> void Application::onMessage(MixedStats& msg)
               << " sntA=" << msg.sntA << " sntB=" << msg.sntB
               << " recvA=" << msg.recvA << " recvB=" << msg.recvB << std::endl;
     repliesCount++;
-    if (repliesCount == 2)
-    {
-        count_mpsc1 = count_mpsc2 = 0;
-        repliesCount = 0;
-        tStart = std::chrono::steady_clock::now();
-        timerStart(123, DURATION_MPSC); // Multiple Producer Single Consumer (actually 2P1C) test
-        snd1->send(MpscBegin{ 1 }); // a number is assigned to each producer
-        snd2->send(MpscBegin{ 2 });
-    }
+    if (repliesCount == 2) startMpsc();
+}
+
+void Application::startMpsc()
+{
+    pooledMessages(pooledRun); // this thread is the consumer
+    lanedMessages(lanedRun);
+    count_mpsc1 = count_mpsc2 = 0;
+    repliesCount = 0;
+    tStart = std::chrono::steady_clock::now();
+    timerStart(123, DURATION_MPSC); // Multiple Producer Single Consumer (actually 2P1C) test
+    snd1->send(MpscBegin{ 1 }); // a number is assigned to each producer
+    snd2->send(MpscBegin{ 2 });
 }
 
 template <> void Application::onMessage(Mpsc& msg)
 {
+    if (msg.id >= MPSC_FIRST_ID) // NP1C scaling
+    {
+        auto index = static_cast<std::size_t>(msg.id - MPSC_FIRST_ID);
+        if (msg.counter > 0)
+        {
+            produced[index] = msg.counter;
+            consumedScaling++;
+        }
+        else if (++repliesCount == static_cast<int>(producers.size())) reportScaling();
+        return;
+    }
     if (msg.counter > 0) // return as fast as possible to cope with the traffic generated from both producers
     {
         (msg.id == 1? count_mpsc1 : count_mpsc2) = msg.counter;
@@ -237,49 +448,496 @@ template <> void Application::onMessage(Mpsc& msg)
         repliesCount++;
         if (repliesCount == 2) // end of 0P1C phase?
         {
-            auto per_second_produced_2p1c = (count_mpsc1 + count_mpsc2) / mpsc_elapsed_lap;
-            auto per_second_consumed_2p1c = (count_mpsc1_lap + count_mpsc2_lap) / mpsc_elapsed_lap;
-            auto sc1 = count_mpsc1 - count_mpsc1_lap;
-            auto sc2 = count_mpsc2 - count_mpsc2_lap;
-            auto elapsed_sc_avg = (mpsc_elapsed_sc1 + mpsc_elapsed_sc2) / 2;
-
-            double min_msgs = std::min(std::min(std::min(count_mpsc1, count_mpsc2), count_mpsc1_lap), count_mpsc2_lap);
-
-            double r_2p1c_p = 1.0 * std::max(count_mpsc1, count_mpsc2) / std::min(count_mpsc1, count_mpsc2);
-            double r_2p1c_c = 1.0 * std::max(count_mpsc1_lap, count_mpsc2_lap) / std::min(count_mpsc1_lap, count_mpsc2_lap);
-            double r_0p1c_c = 1.0 * std::max(sc1, sc2) / std::min(sc1, sc2);
-            double max_ratio = std::max(std::max(r_2p1c_p, r_2p1c_c), r_0p1c_c); // hint of smoothness during the contention
-
-            crazyScheduler = (min_msgs < 100) || (max_ratio > 50);
-
-            std::cout << per_second_produced_2p1c << " msg/sec produced ("
-                      << count_mpsc1 / mpsc_elapsed_lap << " + " << count_mpsc2 / mpsc_elapsed_lap
-                      << ") 2P1C test in " << mpsc_elapsed_lap << " seconds" << std::endl;
-            std::cout << per_second_consumed_2p1c << " msg/sec consumed ("
-                      << count_mpsc1_lap / mpsc_elapsed_lap << " + " << count_mpsc2_lap / mpsc_elapsed_lap
-                      << ") 2P1C test in " << mpsc_elapsed_lap << " seconds" << std::endl;
-            std::cout << (per_second_produced_2p1c + per_second_consumed_2p1c) / 3 << " msg/sec throughput "
-                      << "per thread 2P1C test (priority inversion hint: " << max_ratio << ")" << std::endl;
-            std::cout << (sc1 + sc2) / elapsed_sc_avg << " msg/sec consumed ("
-                      << sc1 / mpsc_elapsed_sc1 << " + " << sc2 / mpsc_elapsed_sc2 << ") 0P1C test in "
-                      << elapsed_sc_avg << " seconds" << std::endl;
-
-            repliesCount = 0;
-            tStart = std::chrono::steady_clock::now(); // start next test
-            bool haveParameter = argc > 1;
-            if (haveParameter)
-                snd1->send(BreedExplode { 2, 1, std::atoi(argv[1]) > 0? std::atoi(argv[1]) : 1 });
+            reportMpsc();
+            if (pooledRun) { pooledRun = false; lanedRun = true; } // then repeat with a lane per producer
+            else if (lanedRun) lanedRun = false;
+            else pooledRun = true; // repeat the test with pooled messages memory
+            if (pooledRun || lanedRun) startMpsc();
             else
-                snd1->send(BreedExplode { 3, 1, 5 }); // by default not too many (valgrind limits friendly)
+            {
+                pooledMessages(false);
+                placementRound = 0;
+                if (placement) startPlacement();
+                else
+                {
+                    scalingRound = 0;
+                    startScaling();
+                }
+            }
+        }
+    }
+}
+
+static int topology(unsigned cpu, const char* item) // e.g. "core_id" (-1 if unknown)
+{
+    std::ifstream file("/sys/devices/system/cpu/cpu" + std::to_string(cpu) + "/topology/" + item); // (Linux)
+    int value = -1;
+    file >> value;
+    return value;
+}
+
+void Application::startPlacement() // a producer on the same core, the same socket or another one than the consumer
+{
+    static const char* labels[] = { "same core", "same socket", "cross socket" };
+    if (placementRound == 3)
+    {
+        scalingRound = 0;
+        startScaling();
+        return;
+    }
+    int package = topology(0, "physical_package_id"), core = topology(0, "core_id");
+    int peer = -1;
+    for (unsigned cpu = 1; (peer < 0) && (cpu < std::thread::hardware_concurrency()); cpu++)
+    {
+        bool samePackage = topology(cpu, "physical_package_id") == package;
+        bool sameCore = samePackage && (topology(cpu, "core_id") == core);
+        if ((placementRound == 0)? sameCore : (placementRound == 1)? samePackage && !sameCore : !samePackage)
+            peer = static_cast<int>(cpu);
+    }
+    if ((placementRound == 0) && (peer < 0)) peer = 0; // no SMT sibling: the very same CPU
+    if ((peer < 0) || (package < 0))
+    {
+        std::cout << "(1P1C " << labels[placementRound] << " test not available on this machine)" << std::endl;
+        placementRound++;
+        startPlacement();
+        return;
+    }
+    Task::Settings pinned;
+    pinned.cpus = { 0 };
+    pinned.name = "sink";
+    placedSink = Task::create(pinned, weak_from_this().lock());
+    pinned.cpus = { static_cast<unsigned>(peer) };
+    pinned.name = "source";
+    placedSource = Task::create(pinned, weak_from_this().lock());
+    placedSource->send(PlacementBegin { placedSink });
+    timerStart(0L, DURATION_PLACEMENT);
+}
+
+template <> void Application::onTimer(const long&) // end of the flood of a placement
+{
+    placedSource->send(PlacementEnd { 0 });
+}
+
+template <> void Application::onMessage(PlacementStats& msg)
+{
+    static const char* labels[] = { "same core", "same socket", "cross socket" };
+    std::cout << msg.produced / msg.elapsed << " msg/sec produced, " << msg.consumed / msg.elapsed
+              << " msg/sec consumed 1P1C test (" << labels[placementRound] << ")" << std::endl;
+    placedSource.reset();
+    placedSink.reset();
+    placementRound++;
+    startPlacement();
+}
+
+void Application::startScaling() // more producers flooding this thread (the contention curve)
+{
+    static const int amounts[] = { 4, 8, 16 };
+    int amount = amounts[scalingRound % 3];
+    lanedMessages(scalingRound >= 3); // second series: a mailbox lane per producer (Settings::lanes)
+    producers.clear();
+    produced.assign(static_cast<std::size_t>(amount), 0);
+    for (int i = 0; i < amount; i++) producers.push_back(Task::create(weak_from_this().lock()));
+    consumedScaling = 0;
+    repliesCount = 0;
+    tStart = std::chrono::steady_clock::now();
+    timerStart(scalingRound, DURATION_NP1C);
+    for (int i = 0; i < amount; i++) producers[static_cast<std::size_t>(i)]->send(MpscBegin{ MPSC_FIRST_ID + i });
+}
+
+template <> void Application::onTimer(const unsigned&) // end of the NP1C phase (the queued messages are drained)
+{
+    scalingElapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - tStart).count();
+    consumedScalingLap = consumedScaling;
+    for (std::size_t i = 0; i < producers.size(); i++)
+        producers[i]->send(MpscEnd{ MPSC_FIRST_ID + static_cast<int>(i) });
+}
+
+void Application::reportScaling()
+{
+    double total = 0;
+    for (auto amount : produced) total += amount;
+    std::cout << total / scalingElapsed << " msg/sec produced, "
+              << static_cast<double>(consumedScalingLap) / scalingElapsed << " msg/sec consumed " << producers.size() << "P1C test" << (scalingRound >= 3? " (lanes)" : "")
+              << " in " << scalingElapsed << " seconds" << std::endl;
+    producers.clear();
+    if (++scalingRound < 6) startScaling();
+    else
+    {
+        lanedMessages(false);
+        startBreeding();
+    }
+}
+
+void Application::startBreeding()
+{
+    repliesCount = 0;
+    breedRound = 0;
+    tStart = std::chrono::steady_clock::now(); // start next test
+    if (generations > 0)
+        breedTest = BreedExplode { 2, 1, generations };
+    else
+        breedTest = BreedExplode { 3, 1, 5 }; // by default not too many (valgrind limits friendly)
+    snd1->send(breedTest); // first with a thread per object
+}
+
+void Application::reportMpsc()
+{
+    auto per_second_produced_2p1c = (count_mpsc1 + count_mpsc2) / mpsc_elapsed_lap;
+    auto per_second_consumed_2p1c = (count_mpsc1_lap + count_mpsc2_lap) / mpsc_elapsed_lap;
+    auto sc1 = count_mpsc1 - count_mpsc1_lap;
+    auto sc2 = count_mpsc2 - count_mpsc2_lap;
+    auto elapsed_sc_avg = (mpsc_elapsed_sc1 + mpsc_elapsed_sc2) / 2;
+
+    double min_msgs = std::min(std::min(std::min(count_mpsc1, count_mpsc2), count_mpsc1_lap), count_mpsc2_lap);
+
+    double r_2p1c_p = 1.0 * std::max(count_mpsc1, count_mpsc2) / std::min(count_mpsc1, count_mpsc2);
+    double r_2p1c_c = 1.0 * std::max(count_mpsc1_lap, count_mpsc2_lap) / std::min(count_mpsc1_lap, count_mpsc2_lap);
+    double r_0p1c_c = 1.0 * std::max(sc1, sc2) / std::min(sc1, sc2);
+    double max_ratio = std::max(std::max(r_2p1c_p, r_2p1c_c), r_0p1c_c); // hint of smoothness during the contention
+
+    crazyScheduler = crazyScheduler || (min_msgs < 100) || (max_ratio > 50);
+
+    std::cout << per_second_produced_2p1c << " msg/sec produced ("
+              << count_mpsc1 / mpsc_elapsed_lap << " + " << count_mpsc2 / mpsc_elapsed_lap
+              << ") 2P1C test in " << mpsc_elapsed_lap << " seconds" << label() << std::endl;
+    std::cout << per_second_consumed_2p1c << " msg/sec consumed ("
+              << count_mpsc1_lap / mpsc_elapsed_lap << " + " << count_mpsc2_lap / mpsc_elapsed_lap
+              << ") 2P1C test in " << mpsc_elapsed_lap << " seconds" << label() << std::endl;
+    std::cout << (per_second_produced_2p1c + per_second_consumed_2p1c) / 3 << " msg/sec throughput "
+              << "per thread 2P1C test (priority inversion hint: " << max_ratio << ")" << label() << std::endl;
+    std::cout << (sc1 + sc2) / elapsed_sc_avg << " msg/sec consumed ("
+              << sc1 / mpsc_elapsed_sc1 << " + " << sc2 / mpsc_elapsed_sc2 << ") 0P1C test in "
+              << elapsed_sc_avg << " seconds" << label() << std::endl;
+}
+
+template <> void Application::onMessage(BreedImplode& msg) // last tests completed
+{
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - tStart).count();
+    if (++breedRound == 1) // repeat the test reusing the threads parked by the previous round
+    {
+        std::cout << msg.implosions << " threads created, communicated and deleted in " << elapsed << " seconds"
+                  << std::endl;
+        breeder = Task::create(weak_from_this().lock());
+        tStart = std::chrono::steady_clock::now();
+        breeder->send(breedTest);
+        return;
+    }
+    if (breedRound == 2) // repeat the test multiplexing the objects over a few threads
+    {
+        std::cout << msg.implosions << " threads created, communicated and deleted in " << elapsed << " seconds"
+                  << " (recycled threads)" << std::endl;
+        Task::Settings multiplexed;
+        multiplexed.scheduler = scheduler = std::make_shared<ActorScheduler>();
+        breeder = Task::create(multiplexed, weak_from_this().lock());
+        tStart = std::chrono::steady_clock::now();
+        breeder->send(breedTest);
+        return;
+    }
+    std::cout << msg.implosions << " actors created, communicated and deleted in " << elapsed << " seconds (M:N with "
+              << scheduler->workers() << " workers)" << std::endl;
+    breeder.reset();
+    scheduler.reset(); // (the workers are stopped along with the last actor)
+    startHibernation();
+}
+
+static Footprint footprint() // (Linux only: zeros elsewhere)
+{
+    Footprint used { 0, 0 };
+#if defined(__GLIBC__) && __GLIBC_PREREQ(2, 33)
+    used.heap = mallinfo2().uordblks; // allocated by the objects (all the arenas)
+#endif
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line))
+    {
+        std::istringstream field(line.substr(line.find(':') + 1));
+        if (line.compare(0, 8, "Threads:") == 0) field >> used.threads;
+    }
+    return used;
+}
+
+static std::size_t threadStack() // reserved for each thread of an awake object (0 if unknown)
+{
+    std::size_t bytes = 0;
+#ifdef __linux__
+    pthread_attr_t attr;
+    if (pthread_attr_init(&attr) == 0)
+    {
+        pthread_attr_getstacksize(&attr, &bytes); // (the default: the Sleepers don't set Settings::stackSize)
+        pthread_attr_destroy(&attr);
+    }
+#endif
+    return bytes;
+}
+
+void Application::startHibernation() // first awake, then lazily spawned and hibernated
+{
+    hibernationRound = 0;
+    timerStart(short(0), IDLE_SETTLE); // (the threads recycled from the previous tests end meanwhile)
+}
+
+void Application::nudgeNext() // one at a time (the round-trip of each one is not delayed by the others)
+{
+    nudgeSent = std::chrono::steady_clock::now();
+    sleepers[nudged]->send(Nudge());
+}
+
+void Application::reportFootprint(const Footprint& used, const char* mode) const
+{   // the object and its mailboxes (heap) plus the stack of its thread (the process totals are too noisy)
+    std::size_t heap = (used.heap > idleBase.heap)? (used.heap - idleBase.heap) / IDLE_ACTORS : 0;
+    int threads = std::max(used.threads - idleBase.threads, 0);
+    std::cout << IDLE_ACTORS << " idle actors take ";
+    if (heap >= sizeof(Sleeper)) std::cout << heap << " bytes of heap each (" << sizeof(Sleeper) << " of the object)";
+    else std::cout << sizeof(Sleeper) << " bytes each plus their mailboxes (heap usage unknown)";
+    std::size_t stack = threadStack();
+    if (!threads) std::cout << " and no thread";
+    else if (stack) std::cout << " plus a " << stack / 1024 << " KB stack reserved per thread";
+    std::cout << " (" << mode << ", " << threads << " threads)" << std::endl;
+}
+
+void Sleeper::onMessage(Nudge&)
+{
+    app->send(Nudged());
+}
+
+template <> void Application::onMessage(Nudged&)
+{
+    nudgesElapsed += std::chrono::duration<double>(std::chrono::steady_clock::now() - nudgeSent).count();
+    if (++nudged < sleepers.size()) return nudgeNext();
+    static const char* const modes[] = { "awake", "first message: thread spawned", "wake from hibernation" };
+    if (hibernationRound == 0) reportFootprint(footprint(), modes[0]);
+    if (hibernationRound == 2) reportFootprint(idleHibernated, "hibernated");
+    std::cout << 1E6 * nudgesElapsed / IDLE_ACTORS << " usec round-trip to an idle actor (" << modes[hibernationRound]
+              << ")" << std::endl;
+    if (hibernationRound == 0) sleepers.clear();
+    if (hibernationRound < 2) timerStart(short(hibernationRound + 1), IDLE_SETTLE);
+    else
+    {
+        sleepers.clear();
+        timersRound = 0;
+        startTimers();
+    }
+}
+
+template <> void Application::onTimer(const short& round) // idle actors settled
+{
+    if (round < 2)
+    {
+        idleBase = footprint();
+        Sleeper::Settings settings;
+        if (round == 1) settings.hibernation = HIBERNATION; // the same actors without a thread until a message comes
+        for (int i = 0; i < IDLE_ACTORS; i++) sleepers.push_back(Sleeper::create(settings, weak_from_this().lock()));
+        if (round == 1) reportFootprint(footprint(), "lazy spawn: not messaged yet");
+    }
+    else idleHibernated = footprint();
+    hibernationRound = unsigned(round);
+    nudged = 0;
+    nudgesElapsed = 0;
+    nudgeNext();
+}
+
+void Application::startTimers() // each amount of timers against both the ordered set and the timing wheel
+{
+    static const int amounts[] = { 1000, 100000, 1000000 };
+    Task::Settings settings;
+    if (timersRound % 2) settings.timerTick = std::chrono::milliseconds(1);
+    clockwork = Task::create(settings, weak_from_this().lock());
+    clockwork->send(TimersBegin { amounts[timersRound / 2] });
+}
+
+template <> void Application::onMessage(TimersEnd& msg)
+{
+    std::cout << msg.started << " started, " << msg.reset << " reset, " << msg.stopped << " stopped, "
+              << msg.fired << " fired timers/sec with " << msg.amount << " live timers"
+              << (timersRound % 2? " (wheel)" : " (ordered)") << std::endl;
+    clockwork.reset();
+    if (++timersRound < 6) startTimers();
+    else
+    {
+        fanoutRound = 0;
+        startFanout();
+    }
+}
+
+void Application::startFanout() // the same amount of deliveries broadcasted to more and more subscribers
+{
+    static const int amounts[] = { 1, 4, 16, 64 };
+    Task::Settings recycled;
+    recycled.pooled = true;
+    ticker = Task::create(recycled, weak_from_this().lock());
+    for (int i = 0; i < amounts[fanoutRound]; i++)
+    {
+        audience.push_back(Task::create(recycled, weak_from_this().lock()));
+        ticker->subscribe<Quote>(audience.back()->weak_from_this());
+    }
+    fanoutPending = amounts[fanoutRound] + 1; // (and the publisher)
+    tStart = std::chrono::steady_clock::now();
+    ticker->send(FanoutBegin { FANOUT_DELIVERIES / amounts[fanoutRound] });
+}
+
+template <> void Application::onMessage(FanoutEnd& msg)
+{
+    if (msg.published >= 0) fanoutPublished = msg.published;
+    if (--fanoutPending) return;
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - tStart).count();
+    double updates = FANOUT_DELIVERIES / static_cast<int>(audience.size());
+    std::cout << 1e9 * fanoutPublished / updates << " nsec per broadcast(), "
+              << 1e9 * elapsed / (updates * static_cast<double>(audience.size())) << " nsec per delivery to "
+              << audience.size() << " subscribers" << std::endl;
+    ticker.reset();
+    audience.clear();
+    if (++fanoutRound < 4) startFanout();
+    else
+    {
+        policyRound = 0;
+        startPolicy();
+    }
+}
+
+void Application::startPolicy() // the default strict priority against a ratio (and a longer burst)
+{
+    Task::Settings policy;
+    if (policyRound)
+    {
+        policy.burst = 256; // (the timers deadlines still cut it short)
+        policy.highPriRatio = 8;
+    }
+    victim = Task::create(policy, weak_from_this().lock());
+    victim->send(PolicyBegin{});
+    for (int i = 0; i < 2; i++)
+    {
+        flooders.push_back(Task::create(weak_from_this().lock()));
+        flooders.back()->send(FloodBegin { victim });
+    }
+    probesSent = 0;
+    timerStart(true, POLICY_PERIOD, TimerCycle::Periodic);
+}
+
+template <> void Application::onTimer(const bool&) // a normal priority probe
+{
+    victim->send(Probe { std::chrono::steady_clock::now() });
+    if (++probesSent < POLICY_PROBES) return;
+    timerStop(true);
+    for (auto& flooder : flooders) flooder->send(FloodStop{});
+}
+
+template <> void Application::onMessage(PolicyStats& msg)
+{
+    std::cout << msg.jitterSum / std::max(msg.ticks - 1, 1) << " usec avg (" << msg.jitterMax << " max) timer jitter, "
+              << msg.latencySum / std::max(msg.probes, 1) << " usec avg (" << msg.latencyMax << " max) latency of "
+              << msg.probes << " normal priority probes under a high priority flood"
+              << (policyRound? " (burst 256, ratio 8:1)" : " (strict priority)") << std::endl;
+    victim.reset();
+    flooders.clear();
+    if (++policyRound < 2) startPolicy();
+    else
+    {
+        Summer<false>::Settings longBurst;
+        longBurst.burst = SAMPLES_BURST;
+        summer = Summer<false>::create(longBurst, weak_from_this().lock());
+        summer->send(SamplesBegin { SAMPLES });
+    }
+}
+
+template <bool Batched> void Summer<Batched>::onMessage(SamplesBegin& msg) // queues them to itself
+{
+    sum = 0;
+    amount = msg.amount;
+    std::vector<Sample> samples;
+    samples.reserve(static_cast<std::size_t>(amount));
+    for (int i = 0; i < amount; i++) samples.push_back(Sample { i * 0.5 });
+    this->sendBatch(samples.begin(), samples.end());
+    this->send(SamplesEnd{});
+    tStart = std::chrono::steady_clock::now(); // (only the consumption is measured)
+}
+
+template <bool Batched> void Summer<Batched>::onMessage(SamplesEnd&)
+{
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - tStart).count();
+    std::lock_guard<std::mutex> lock(totalMtx);
+    app->send(SamplesRate { amount, elapsed, total, Batched });
+    app.reset(); // (circular reference)
+}
+
+template <> void Application::onMessage(SamplesRate& msg)
+{
+    double expected = 0.5 * SAMPLES * (SAMPLES - 1) / 2;
+    std::cout << 1e9 * msg.elapsed / msg.amount << " nsec per sample added (publishing the total under a lock per call) "
+              << (msg.batched? "in runs by onMessages()" : "one by one by onMessage()")
+              << (std::fabs(msg.sum - expected) < 1? "" : " (WRONG SUM)") << std::endl;
+    if (!msg.batched)
+    {
+        summer.reset();
+        Summer<true>::Settings longBurst;
+        longBurst.burst = SAMPLES_BURST;
+        batchSummer = Summer<true>::create(longBurst, weak_from_this().lock());
+        batchSummer->send(SamplesBegin { SAMPLES });
+        return;
+    }
+    batchSummer.reset();
+    pipelineRound = 0;
+    startPipeline();
+}
+
+static const int packetsAmounts[] = { 100000, 10000 }; // per round of the buffers test
+static const std::size_t packetsSizes[] = { 1500, 65536 };
+
+void Application::startPipeline() // each size first copied and then sliced
+{
+    Relay::Settings bounded;
+    bounded.capacity = PIPELINE_CAPACITY;
+    pipeline.reset();
+    for (int i = 0; i < PIPELINE_STAGES; i++) pipeline = Relay::create(bounded, weak_from_this().lock(), pipeline);
+    tStart = std::chrono::steady_clock::now();
+    auto round = pipelineRound / 2;
+    pipeline->send(PacketsBegin { packetsAmounts[round], packetsSizes[round], (pipelineRound % 2) != 0 });
+}
+
+void Relay::onMessage(PacketsBegin& msg) // the source (filling them as if read from a socket)
+{
+    for (int i = 0; i < msg.amount; i++)
+    {
+        bool last = i == msg.amount - 1;
+        if (msg.zeroCopy)
+        {
+            auto buffer = ActorBuffer::allocate(msg.size);
+            std::memset(buffer.data(), i, buffer.size());
+            next->send(Packet { std::move(buffer), last });
         }
+        else next->send(CopiedPacket { std::vector<char>(msg.size, char(i)), last });
     }
 }
 
-template <> void Application::onMessage(BreedImplode& msg) // last test completed
+void Relay::onMessage(Packet& msg)
 {
+    if (!next) return received(msg.bytes.data(), msg.bytes.size(), msg.last);
+    next->send(Packet { msg.bytes.slice(PIPELINE_HEADER), msg.last });
+}
+
+void Relay::onMessage(CopiedPacket& msg)
+{
+    if (!next) return received(msg.bytes.data(), msg.bytes.size(), msg.last);
+    next->send(CopiedPacket { std::vector<char>(msg.bytes.begin() + PIPELINE_HEADER, msg.bytes.end()), msg.last });
+}
+
+void Relay::received(const char* bytes, std::size_t size, bool last)
+{
+    if (bytes[0] == bytes[size - 1]) checksum += long(size); // (the source fills each one with the same value)
+    if (last) app->send(PacketsEnd { checksum });
+}
+
+template <> void Application::onMessage(PacketsEnd& msg)
+{
+    int amount = packetsAmounts[pipelineRound / 2];
+    std::size_t size = packetsSizes[pipelineRound / 2];
+    long expected = amount * long(size - (PIPELINE_STAGES - 2) * PIPELINE_HEADER); // (the intermediate stages slice)
     auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - tStart).count();
-    std::cout << msg.implosions << " threads created, communicated and deleted in " << elapsed << " seconds" << std::endl;
-    timerStart('H', std::chrono::milliseconds(500)); // leave time for detached threads to stop (avoid memory leaks)
+    std::cout << amount / elapsed << " packets/sec (" << 1e-6 * amount * double(size) / elapsed << " MB/sec) of " << size
+              << " bytes through " << PIPELINE_STAGES << " actors" << ((pipelineRound % 2)? " (ActorBuffer slices)"
+              : " (std::vector copies)") << (msg.checksum == expected? "" : " (WRONG CHECKSUM)") << std::endl;
+    pipeline.reset();
+    if (++pipelineRound < 4) startPipeline();
+    else timerStart('H', std::chrono::milliseconds(500)); // leave time for detached threads to stop (avoid leaks)
 }
 
 template <> void Application::onTimer(const int&) // end of 2P1C phase
@@ -299,13 +957,18 @@ template <> void Application::onTimer(const char&) // end of application
                   << "Advice: when running under valgrind the \"--fair-sched=yes\" option is recommended"
                   << std::endl << std::endl;
 
-    snd1->send(Task::ptr()); // remove circular reference (avoid valgrind
-    snd2->send(Task::ptr()); // "possibly lost" message regarding memory)
-    snd1->waitIdle();
-    snd2->waitIdle();
+    for (auto task : { snd1, snd2, mix1, mix2, spin1, spin2 })
+    {
+        task->send(Task::ptr()); // remove circular reference (avoid valgrind
+        task->waitIdle();        // "possibly lost" message regarding memory)
+    }
 
     snd1.reset(); // remove them to wipe their reference to us preventing
     snd2.reset(); // our deletion (another valgrind "possibly lost")
+    mix1.reset();
+    mix2.reset();
+    spin1.reset();
+    spin2.reset();
 
     stop();
 }
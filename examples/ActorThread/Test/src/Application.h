@@ -9,13 +9,17 @@
 
 #include <random>
 #include <set>
+#include <vector>
 #include <sys++/ActorThread.hpp>
+#include <sys++/ActorBuffer.hpp>
 
 struct SyncBegin { bool master; };
 struct SyncMsg { int counter; };
 struct SyncEnd { int counter; };
 
-struct AsyncBegin {};
+struct Pooling { bool enable; };
+
+struct AsyncBegin { bool batched; };
 struct AsyncMsg { int counter; bool last; };
 struct AsyncEnd { int counter; };
 
@@ -29,17 +33,53 @@ struct MpscBegin { int id; };
 struct Mpsc { int id; int counter; };
 struct MpscEnd { int id; };
 
+struct PlacementBegin { std::shared_ptr<class Task> sink; };
+struct Placed { int counter; }; // 1P1C flood between pinned threads
+struct PlacementEnd { int produced; };
+struct PlacementStats { int produced, consumed; double elapsed; }; // (consumer side since the first message)
+
 struct BreedExplode { int amount; int generation; int maxGenerations; };
 struct BreedImplode { std::shared_ptr<class Task> child; int implosions; };
 
+struct TimersBegin { int amount; };
+struct TimersEnd { int amount; double started, reset, stopped, fired; }; // rates (per second)
+
+struct FanoutBegin { int updates; };
+struct Quote { int seq; double bid, ask; bool last; }; // broadcasted (shared by all the subscribers)
+struct FanoutEnd { double published; }; // seconds spent by the publisher
+
+struct PolicyBegin {};
+struct FloodBegin { std::shared_ptr<class Task> target; };
+struct Flood {}; // high priority traffic
+struct FloodStop {};
+struct FloodEnd {};
+struct Probe { std::chrono::steady_clock::time_point sent; }; // normal priority
+struct PolicyEnd {};
+struct PolicyStats { int ticks, probes; double jitterSum, jitterMax, latencySum, latencyMax; }; // usec
+
+struct SamplesBegin { int amount; };
+struct Sample { double value; };
+struct SamplesEnd {};
+struct SamplesRate { int amount; double elapsed, sum; bool batched; };
+
+struct Nudge {}; // to an idle actor (awake, not yet spawned or hibernated)
+struct Nudged {};
+
+struct Footprint { std::size_t heap; int threads; }; // of the whole process (heap bytes in use: 0 if unknown)
+
+struct PacketsBegin { int amount; std::size_t size; bool zeroCopy; };
+struct Packet { ActorBuffer bytes; bool last; }; // each stage slices its header off (sharing the bytes)
+struct CopiedPacket { std::vector<char> bytes; bool last; }; // each stage copies the bytes after its header
+struct PacketsEnd { long checksum; };
+
 class Task : public ActorThread<Task>
 {
     friend ActorThread<Task>;
 
     Task(std::shared_ptr<class Application> parent)
       : app(parent), gen(std::random_device{}()), rnd(0,9),
-        syncTestCompleted(false), mixedTestCompleted(false), mixedTestPaused(false),
-        fstats { 0, 0, 0, 0 }, implosions(0) {}
+        syncTestCompleted(false), mixedTestCompleted(false),
+        fstats { 0, 0, 0, 0 }, implosions(0), placed(0) {}
 
     Task(Task::ptr parent) : ancestor(parent), implosions(0) {} // for breeding test
 
@@ -55,20 +95,89 @@ class Task : public ActorThread<Task>
 
     bool syncTestCompleted;
     bool mixedTestCompleted;
-    bool mixedTestPaused;
 
     MixedStats fstats;
 
     Task::ptr ancestor;
     std::set<Task::ptr> pendingChilds;
     int implosions;
+
+    TimersEnd timersBench;
+    int timersFired;
+    std::chrono::steady_clock::time_point firstFire;
+
+    PolicyStats policyStats; // dispatch policy test
+    std::chrono::steady_clock::time_point lastTick;
+    int floodsEnded;
+
+    Task::ptr sink; // placement test (producer side)
+    int placed; // produced or consumed
+    std::chrono::steady_clock::time_point firstPlaced;
+};
+
+template <bool Batched> class Summer : public ActorThread<Summer<Batched>> // adds numeric samples
+{
+    friend ActorThread<Summer<Batched>>;
+
+    Summer(std::shared_ptr<class Application> parent) : app(parent), sum(0), total(0), amount(0) {}
+
+    typedef typename std::conditional<Batched, ActorMessages<Sample>, ActorMessages<>>::type batched;
+
+    void onMessage(SamplesBegin&);
+    void onMessage(Sample& msg) { onMessages(&msg, 1); }
+    void onMessages(Sample* msgs, std::size_t count)
+    {
+        for (std::size_t i = 0; i < count; i++) sum += msgs[i].value;
+        std::lock_guard<std::mutex> lock(totalMtx); // (a fixed cost per invocation)
+        total = sum;
+    }
+    void onMessage(SamplesEnd&);
+
+    std::shared_ptr<class Application> app;
+    double sum;
+    std::mutex totalMtx;
+    double total; // running sum readable from other threads
+    int amount;
+    std::chrono::steady_clock::time_point tStart;
+};
+
+class Sleeper : public ActorThread<Sleeper> // idle most of the time
+{
+    friend ActorThread<Sleeper>;
+
+    Sleeper(std::shared_ptr<class Application> parent) : app(parent) {}
+
+    void onMessage(Nudge&);
+
+    std::shared_ptr<class Application> app;
+};
+
+class Relay : public ActorThread<Relay> // a stage of the buffers pipeline (the first one produces them)
+{
+    friend ActorThread<Relay>;
+
+    Relay(std::shared_ptr<class Application> parent, Relay::ptr following) : app(parent), next(following), checksum(0) {}
+
+    void onMessage(PacketsBegin&);
+    void onMessage(Packet&);
+    void onMessage(CopiedPacket&);
+    void received(const char* bytes, std::size_t size, bool last); // the last stage
+
+    std::shared_ptr<class Application> app;
+    Relay::ptr next;
+    long checksum;
 };
 
 class Application : public ActorThread<Application>
 {
     friend ActorThread<Application>;
 
-    Application(int cmdArgc, char** cmdArgv) : argc(cmdArgc), argv(cmdArgv) {}
+    Application(int cmdArgc, char** cmdArgv)
+      : argc(cmdArgc), argv(cmdArgv), generations(0), placement(false),
+        pooledRun(false), batchedRun(false), lanedRun(false), crazyScheduler(false) {}
+
+    typedef ActorMessages<Mpsc, SyncEnd, AsyncEnd, MixedStats, BreedImplode, TimersEnd, FanoutEnd,
+                           PolicyStats, SamplesRate, PlacementStats, Nudged, PacketsEnd> messages;
 
     void onStart();
 
@@ -77,15 +186,86 @@ class Application : public ActorThread<Application>
 
     const int argc;
     char** const argv;
+    int generations; // of the breeding test (command line number)
+    bool placement; // "--placement" command line flag: run the 1P1C placement test after the MPSC one
 
     Task::ptr snd1;
     Task::ptr snd2;
+    Task::ptr mix1; // bounded mailboxes (flow control for the mixed test)
+    Task::ptr mix2;
+    Task::ptr spin1; // idle strategy: spin, then yield, then sleep
+    Task::ptr spin2;
+    Task::ptr breeder; // root of the recycled threads and M:N breeding tests
+    unsigned breedRound;
+    std::shared_ptr<ActorScheduler> scheduler;
+
+    Task::ptr clockwork; // timers test
+    unsigned timersRound;
+    void startTimers();
+
+    Task::ptr ticker; // fan-out test
+    std::vector<Task::ptr> audience;
+    unsigned fanoutRound;
+    int fanoutPending;
+    double fanoutPublished;
+    void startFanout();
+
+    Task::ptr victim; // dispatch policy test (flooded with high priority messages)
+    std::vector<Task::ptr> flooders;
+    unsigned policyRound;
+    int probesSent;
+    void startPolicy();
+
+    std::vector<Sleeper::ptr> sleepers; // hibernation test (footprint and round-trip of idle actors)
+    unsigned hibernationRound;
+    std::size_t nudged;
+    Footprint idleBase; // before creating them
+    Footprint idleHibernated;
+    std::chrono::steady_clock::time_point nudgeSent;
+    double nudgesElapsed;
+    void startHibernation();
+    void nudgeNext();
+    void reportFootprint(const Footprint& used, const char* mode) const;
+
+    Summer<false>::ptr summer; // batch delivery test (one by one against in runs)
+    Summer<true>::ptr batchSummer;
+
+    Relay::ptr pipeline; // buffers test (the source of the stages)
+    unsigned pipelineRound;
+    void startPipeline();
+
+    BreedExplode breedTest;
 
     std::chrono::steady_clock::time_point tStart;
     int repliesCount;
 
+    void startMpsc();
+    void reportMpsc();
+
+    Task::ptr placedSource; // CPU placement test (consumer on the CPU 0)
+    Task::ptr placedSink;
+    unsigned placementRound;
+    void startPlacement();
+
+    bool pooledRun; // second round of the async and MPSC tests using the Settings::pooled mode
+    bool batchedRun; // third round of the async test using sendBatch()
+    bool lanedRun; // third round of the MPSC test using Settings::lanes (small messages stored inline)
+    const char* label() const
+    {
+        return batchedRun? " (batched)" : lanedRun? " (lanes)" : pooledRun? " (pooled)" : " (heap)";
+    }
+
     int count_mpsc1, count_mpsc2, count_mpsc1_lap, count_mpsc2_lap;
     double mpsc_elapsed_lap, mpsc_elapsed_sc1, mpsc_elapsed_sc2;
+
+    std::vector<Task::ptr> producers; // NP1C scaling (ids from MPSC_FIRST_ID onwards)
+    std::vector<int> produced;
+    unsigned scalingRound;
+    long consumedScaling, consumedScalingLap;
+    double scalingElapsed;
+    void startScaling();
+    void reportScaling();
+    void startBreeding();
     bool crazyScheduler;
 };
 
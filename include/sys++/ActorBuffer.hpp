@@ -0,0 +1,315 @@
+// Zero-copy reference counted buffers for ActorThread messages (https://github.com/lightful/syscpp)
+//
+//       Copyright Ciriaco Garcia de Celis 2016-2017.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+/*
+ - ActorBuffer::allocate() returns uninitialized bytes carved from size-classed slabs (capacities of 256 B to 64 KiB)
+ - Copies and slice()s share the bytes through a single intrusive reference count (no control block, no memcpy)
+ - Fill it (e.g. read() a packet into data() and resize() it to the bytes read) before sharing it: then it's immutable
+ - Move it into the messages: the last holder returns it to the freelist of the thread which allocated it (lock-free)
+ - The slabs are kept for reuse until the process ends (ActorBuffer::hugePages() backs the new ones with 2 MiB pages)
+ - Larger buffers are plain heap blocks with the same interface
+ */
+#ifndef ACTORBUFFER_HPP
+#define ACTORBUFFER_HPP
+
+#include <atomic>
+#include <mutex>
+#include <algorithm>
+#include <vector>
+#include <new>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+class ActorBuffer
+{
+    class Pool;
+
+    struct Block // precedes the bytes (padded to a cache line)
+    {
+        std::atomic<std::size_t> refs; // holders (buffers and slices)
+        Pool* owner; // nullptr for plain heap blocks
+        union { Block* next; std::size_t sizeClass; }; // 'next' while free, 'sizeClass' while in use
+        std::size_t capacity;
+    };
+
+    public:
+
+        static const std::size_t npos = std::size_t(-1);
+
+        ActorBuffer() : block(nullptr), offset(0), length(0) {}
+
+        ActorBuffer(const ActorBuffer& other) : block(other.block), offset(other.offset), length(other.length)
+        {
+            if (block) block->refs.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        ActorBuffer(ActorBuffer&& other) noexcept : block(other.block), offset(other.offset), length(other.length)
+        {
+            other.block = nullptr;
+            other.offset = other.length = 0;
+        }
+
+        ActorBuffer& operator=(ActorBuffer other) noexcept // (copy or move)
+        {
+            swap(other);
+            return *this;
+        }
+
+        ~ActorBuffer() { release(); }
+
+        static ActorBuffer allocate(std::size_t bytes) // of unspecified contents (from the calling thread freelists)
+        {
+            std::size_t sizeClass = 0;
+            while ((sizeClass < Classes) && (bytes > classBytes(sizeClass))) sizeClass++;
+            Block* fresh;
+            if (sizeClass == Classes) // too big for the slabs
+            {
+                fresh = new (::operator new(HeaderBytes + bytes)) Block;
+                fresh->owner = nullptr;
+                fresh->capacity = bytes;
+            }
+            else fresh = Pool::local().take(sizeClass);
+            fresh->refs.store(1, std::memory_order_relaxed);
+            return ActorBuffer(fresh, 0, bytes);
+        }
+
+        static ActorBuffer copyOf(const void* bytes, std::size_t size)
+        {
+            auto buffer = allocate(size);
+            if (size) std::memcpy(buffer.data(), bytes, size);
+            return buffer;
+        }
+
+        char* data() { return block? bytes(block) + offset : nullptr; } // (don't write it once shared)
+        const char* data() const { return block? bytes(block) + offset : nullptr; }
+        std::size_t size() const { return length; }
+        bool empty() const { return !length; }
+        std::size_t capacity() const { return block? block->capacity - offset : 0; } // from data() onwards
+
+        void resize(std::size_t bytes) // up to capacity() (e.g. to the amount read into it)
+        {
+            if (bytes > capacity()) throw std::length_error("ActorBuffer::resize");
+            length = bytes;
+        }
+
+        ActorBuffer slice(std::size_t from, std::size_t count = npos) const // shares the bytes (clamped to size())
+        {
+            if (!block || (from >= length)) return ActorBuffer();
+            block->refs.fetch_add(1, std::memory_order_relaxed);
+            return ActorBuffer(block, offset + from, std::min(count, length - from));
+        }
+
+        bool unique() const { return block && (block->refs.load(std::memory_order_acquire) == 1); } // safe to write
+
+        void reset()
+        {
+            release();
+            block = nullptr;
+            offset = length = 0;
+        }
+
+        void swap(ActorBuffer& other) noexcept
+        {
+            std::swap(block, other.block);
+            std::swap(offset, other.offset);
+            std::swap(length, other.length);
+        }
+
+        static void hugePages(bool enable) // for the slabs allocated from now on (Linux only: ignored elsewhere)
+        {
+            huge().store(enable, std::memory_order_relaxed);
+        }
+
+    private:
+
+        enum { Classes = 9 }; // capacities of 256, 512, 1K, 2K, 4K, 8K, 16K, 32K and 64K bytes
+
+        static const std::size_t HeaderBytes = 64; // (keeps the bytes of the slabs cache line aligned)
+        static const std::size_t SlabBytes = std::size_t(2) << 20; // (a huge page)
+
+        static std::size_t classBytes(std::size_t sizeClass) { return std::size_t(256) << sizeClass; }
+
+        static char* bytes(Block* owned) { return reinterpret_cast<char*>(owned) + HeaderBytes; }
+
+        static std::atomic<bool>& huge() { static std::atomic<bool> enabled(false); return enabled; }
+
+        ActorBuffer(Block* owned, std::size_t from, std::size_t bytes) : block(owned), offset(from), length(bytes) {}
+
+        void release()
+        {
+            if (!block) return; // (a sole holder skips the atomic decrement: nobody else can reference it)
+            if ((block->refs.load(std::memory_order_acquire) != 1)
+                && (block->refs.fetch_sub(1, std::memory_order_acq_rel) != 1)) return;
+            if (!block->owner) ::operator delete(block);
+            else Pool::recycle(block);
+        }
+
+        class Pool // per-thread freelists (the ActorPool scheme carving the blocks from slabs never freed)
+        {
+            public:
+
+                static Pool& local()
+                {
+                    static thread_local Lease lease;
+                    return *lease.pool;
+                }
+
+                static void recycle(Block* used) // runs on any thread (usually the last consumer one)
+                {
+                    Pool* owner = used->owner;
+                    if (owner == current()) owner->keep(used);
+                    else owner->giveBack(used); // lock-free return to the thread which allocated it
+                }
+
+                Block* take(std::size_t sizeClass)
+                {
+                    Block* taken = freeList[sizeClass];
+                    if (!taken) taken = reclaim(sizeClass);
+                    if (taken) freeList[sizeClass] = taken->next;
+                    else taken = carve(sizeClass); // the steady state is reached when every buffer in flight exists
+                    taken->sizeClass = sizeClass;
+                    return taken;
+                }
+
+            private:
+
+                Pool()
+                {
+                    for (std::size_t i = 0; i < Classes; i++)
+                    {
+                        freeList[i] = nullptr;
+                        slab[i] = nullptr;
+                        slabLeft[i] = 0;
+                        returned[i].store(nullptr, std::memory_order_relaxed);
+                    }
+                }
+
+                Block* reclaim(std::size_t sizeClass) // adopt the blocks returned by other threads (single exchange)
+                {
+                    Block* chain = returned[sizeClass].exchange(nullptr, std::memory_order_acquire);
+                    while (chain)
+                    {
+                        Block* next = chain->next;
+                        keep(chain, sizeClass);
+                        chain = next;
+                    }
+                    return freeList[sizeClass];
+                }
+
+                void keep(Block* used) { keep(used, used->sizeClass); }
+
+                void keep(Block* used, std::size_t sizeClass)
+                {
+                    used->next = freeList[sizeClass];
+                    freeList[sizeClass] = used;
+                }
+
+                void giveBack(Block* used)
+                {
+                    auto& stack = returned[used->sizeClass];
+                    Block* top = stack.load(std::memory_order_relaxed);
+                    do used->next = top; // (only the owner pops, and does it all at once, so there is no ABA problem)
+                    while (!stack.compare_exchange_weak(top, used, std::memory_order_release, std::memory_order_relaxed));
+                }
+
+                Block* carve(std::size_t sizeClass)
+                {
+                    std::size_t stride = HeaderBytes + classBytes(sizeClass);
+                    if (slabLeft[sizeClass] < stride)
+                    {
+                        slab[sizeClass] = static_cast<char*>(newSlab());
+                        slabLeft[sizeClass] = SlabBytes;
+                    }
+                    Block* carved = new (slab[sizeClass]) Block;
+                    slab[sizeClass] += stride;
+                    slabLeft[sizeClass] -= stride;
+                    carved->owner = this;
+                    carved->capacity = classBytes(sizeClass);
+                    return carved;
+                }
+
+                static void* newSlab()
+                {
+#ifdef __linux__
+                    if (huge().load(std::memory_order_relaxed))
+                    {
+                        void* pages = mmap(nullptr, SlabBytes, PROT_READ | PROT_WRITE,
+                                           MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0); // (reserved ones)
+                        if (pages != MAP_FAILED) return pages;
+                        pages = mmap(nullptr, 2 * SlabBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+                        if (pages == MAP_FAILED) throw std::bad_alloc();
+                        auto address = reinterpret_cast<uintptr_t>(pages); // transparent ones: aligned to their size
+                        auto aligned = (address + SlabBytes - 1) & ~uintptr_t(SlabBytes - 1);
+                        if (aligned > address) munmap(pages, aligned - address);
+                        munmap(reinterpret_cast<void*>(aligned + SlabBytes), address + SlabBytes - aligned);
+                        madvise(reinterpret_cast<void*>(aligned), SlabBytes, MADV_HUGEPAGE);
+                        return reinterpret_cast<void*>(aligned);
+                    }
+#endif
+                    return ::operator new(SlabBytes);
+                }
+
+                struct Orphans // pools whose thread exited (the buffers still in flight keep pointing them)
+                {
+                    std::mutex mtx;
+                    std::vector<Pool*> pools;
+                };
+
+                static Orphans& orphans()
+                {
+                    static Orphans* registry = new Orphans; // never deleted: buffers could still be released at exit
+                    return *registry;
+                }
+
+                struct Lease // binds a pool to the current thread (the pools and their slabs are never freed)
+                {
+                    Lease()
+                    {
+                        auto& registry = orphans();
+                        std::lock_guard<std::mutex> lock(registry.mtx);
+                        if (registry.pools.empty()) pool = new Pool;
+                        else // recycle the pool (and the free blocks) of an exited thread
+                        {
+                            pool = registry.pools.back();
+                            registry.pools.pop_back();
+                        }
+                        current() = pool;
+                    }
+                    ~Lease()
+                    {
+                        current() = nullptr;
+                        auto& registry = orphans();
+                        std::lock_guard<std::mutex> lock(registry.mtx);
+                        registry.pools.push_back(pool);
+                    }
+                    Pool* pool;
+                };
+
+                static Pool*& current() // (trivially initialized: cheap to query from the consumer)
+                {
+                    static thread_local Pool* pool = nullptr;
+                    return pool;
+                }
+
+                Block* freeList[Classes]; // owner thread only
+                char* slab[Classes]; // being carved
+                std::size_t slabLeft[Classes];
+                char padding[64]; // keep apart the cache lines written by other threads
+                std::atomic<Block*> returned[Classes];
+        };
+
+        Block* block;
+        std::size_t offset;
+        std::size_t length;
+};
+
+#endif /* ACTORBUFFER_HPP */
@@ -0,0 +1,463 @@
+// Asynchronous file and socket I/O for ActorThread active objects (https://github.com/lightful/syscpp)
+//
+//       Copyright Ciriaco Garcia de Celis 2016-2017.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+/*
+ - Create a shared ActorIO service and submit read() / write() / fsync() / accept() requests from any active object
+ - The completions are delivered as onMessage(ActorIO::Completion&) through a link of the requester (see getLink())
+   or complete a Pending<ActorIO::Completion> given by its path() (see expect(): e.g. co_await it from a Coro)
+ - Backed by io_uring (the requests queued meanwhile are submitted with a single system call) or, when it is
+   unavailable (or lacks the operations used: before kernel 5.6), by a small pool of threads performing the
+   equivalent blocking calls
+ - fsync() waits for the previously submitted operations (a barrier) and the others can complete in any order
+ - Pending operations are completed with -ECANCELED when the service is deleted (those already started complete)
+ - Linux only
+ */
+#ifndef ACTORIO_HPP
+#define ACTORIO_HPP
+
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <sys++/ActorThread.hpp>
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#define ACTORIO_URING 1
+#endif
+#endif
+
+class ActorIO
+{
+    public:
+
+        enum class Op { Read, Write, Fsync, Accept };
+
+        struct Completion
+        {
+            Op op;
+            int fd;
+            long result; // bytes transferred (or the accepted descriptor) if not negative, otherwise -errno
+            std::vector<char> data; // the bytes read (or the written ones, given back for reuse)
+            uint64_t tag; // as given in the request
+        };
+
+        class Requester // where the completions are delivered
+        {
+            public:
+                Requester() {}
+                Requester(ActorLink<Completion> link) : to(std::move(link)) {} // e.g. getLink<ActorIO::Completion>()
+                Requester(std::shared_ptr<ActorAsk> path) : reply(std::move(path)) {} // e.g. expect<>().path()
+                explicit operator bool() const { return to || reply; }
+                bool operator()(Completion& done) const // (false if the requester was deleted)
+                {
+                    if (to) return to(done);
+                    auto pending = dynamic_cast<ActorAskFor<Completion>*>(reply.get());
+                    return pending && pending->answer(std::move(done));
+                }
+            private:
+                ActorLink<Completion> to; // (better obtained once)
+                std::shared_ptr<ActorAsk> reply; // a single completion
+        };
+
+        static std::shared_ptr<ActorIO> create(unsigned depth = 256, unsigned threads = 2, bool uring = true)
+        {   // depth: maximum operations in flight on io_uring / threads: of the fallback (or forced if !uring)
+            return std::shared_ptr<ActorIO>(new ActorIO(depth, threads, uring));
+        }
+
+        ~ActorIO()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                stopping = true;
+                workAvailable.notify_all();
+            }
+            if (ring) signal();
+            for (auto& worker : workers) worker.join();
+#ifdef ACTORIO_URING
+            if (ring) unmapRing();
+#endif
+            if (wakeFd >= 0) close(wakeFd);
+        }
+
+        bool uring() const { return ring; } // false if using the threads fallback
+
+        bool read(const Requester& to, int fd, std::size_t size, int64_t offset = -1, uint64_t tag = 0)
+        {   // offset -1: from the current file position (also for sockets and pipes)
+            return submit(to, Op::Read, fd, std::vector<char>(size), offset, tag);
+        }
+
+        bool write(const Requester& to, int fd, std::vector<char> data, int64_t offset = -1, uint64_t tag = 0)
+        {
+            return submit(to, Op::Write, fd, std::move(data), offset, tag);
+        }
+
+        bool fsync(const Requester& to, int fd, uint64_t tag = 0)
+        {
+            return submit(to, Op::Fsync, fd, std::vector<char>(), 0, tag);
+        }
+
+        bool accept(const Requester& to, int fd, uint64_t tag = 0) // (the new connection is the Completion::result)
+        {
+            return submit(to, Op::Accept, fd, std::vector<char>(), 0, tag);
+        }
+
+    private:
+
+        ActorIO& operator=(const ActorIO&) = delete;
+        ActorIO(const ActorIO&) = delete;
+
+        struct Request
+        {
+            Op op;
+            int fd;
+            int64_t offset;
+            std::vector<char> data;
+            uint64_t tag;
+            Requester requester;
+            uint64_t sequence; // submission order (see fsync())
+        };
+
+        ActorIO(unsigned depth, unsigned threads, bool uring)
+          : ring(false), wakeFd(-1), stopping(false), sequence(0)
+        {
+#ifdef ACTORIO_URING
+            if (uring) ring = setupRing(std::max(depth, 2u));
+#else
+            (void) depth;
+            (void) uring;
+#endif
+            if (ring) workers.emplace_back(&ActorIO::reaper, this);
+            else for (unsigned i = 0; i < std::max(threads, 1u); i++) workers.emplace_back(&ActorIO::worker, this);
+        }
+
+        bool submit(const Requester& to, Op op, int fd, std::vector<char>&& data, int64_t offset, uint64_t tag)
+        {
+            if (!to) return false;
+            std::unique_ptr<Request> request(new Request { op, fd, offset, std::move(data), tag, to, 0 });
+            bool wasIdle;
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                if (stopping) return false;
+                wasIdle = queue.empty();
+                request->sequence = sequence++;
+                queue.push_back(std::move(request));
+                if (!ring) workAvailable.notify_one();
+            }
+            if (ring && wasIdle) signal(); // the reaper drains everything queued meanwhile (batched submission)
+            return true;
+        }
+
+        static void complete(std::unique_ptr<Request>& request, long result)
+        {
+            Completion done { request->op, request->fd, result, std::move(request->data), request->tag };
+            if ((request->op == Op::Read) && (result >= 0)) done.data.resize(static_cast<std::size_t>(result));
+            request->requester(done); // (discarded if the requester was deleted)
+        }
+
+        void signal()
+        {
+            uint64_t one = 1;
+            if (::write(wakeFd, &one, sizeof(one)) < 0) return; // (EAGAIN: the counter is already huge)
+        }
+
+        /* fallback: blocking calls on a pool of threads */
+
+        void worker()
+        {
+            for (;;)
+            {
+                std::unique_ptr<Request> request;
+                {
+                    std::unique_lock<std::mutex> ulock(mtx);
+                    workAvailable.wait(ulock, [this] { return stopping || !queue.empty(); });
+                    if (queue.empty()) return;
+                    request = std::move(queue.front());
+                    queue.pop_front();
+                    running.insert(request->sequence);
+                    if (request->op == Op::Fsync) // barrier
+                        barrier.wait(ulock, [this, &request] { return *running.begin() == request->sequence; });
+                }
+                long result = stopping? -ECANCELED : perform(*request);
+                {
+                    std::lock_guard<std::mutex> lock(mtx);
+                    running.erase(request->sequence);
+                    barrier.notify_all();
+                }
+                complete(request, result);
+            }
+        }
+
+        long perform(Request& request) // (with a stop check while waiting for sockets and pipes)
+        {
+            if (request.op == Op::Fsync) return ::fsync(request.fd) < 0? -errno : 0;
+            for (;;)
+            {
+                pollfd ready = { request.fd, static_cast<short>(request.op == Op::Write? POLLOUT : POLLIN), 0 };
+                int events = poll(&ready, 1, 100);
+                if (stopping) return -ECANCELED;
+                if ((events < 0) && (errno != EINTR)) return -errno;
+                if (events <= 0) continue;
+                ssize_t result;
+                auto buffer = request.data.data();
+                auto size = request.data.size();
+                auto offset = static_cast<off_t>(request.offset);
+                switch (request.op)
+                {
+                    case Op::Read:
+                        result = request.offset < 0? ::read(request.fd, buffer, size)
+                                                   : pread(request.fd, buffer, size, offset);
+                        break;
+                    case Op::Write:
+                        result = request.offset < 0? ::write(request.fd, buffer, size)
+                                                   : pwrite(request.fd, buffer, size, offset);
+                        break;
+                    default:
+                        result = accept4(request.fd, nullptr, nullptr, SOCK_CLOEXEC);
+                        break;
+                }
+                if (result >= 0) return static_cast<long>(result);
+                if ((errno != EAGAIN) && (errno != EWOULDBLOCK) && (errno != EINTR)) return -errno;
+            }
+        }
+
+#ifdef ACTORIO_URING
+
+        /* io_uring (through the raw system calls: no liburing dependency) */
+
+        enum : uint64_t { WakeTag = 0, CancelTag = 1, FirstTag = 2 }; // user_data (FirstTag + Request::sequence)
+
+        bool setupRing(unsigned depth)
+        {
+            io_uring_params params = io_uring_params();
+            long fd = syscall(__NR_io_uring_setup, depth, &params);
+            if (fd < 0) return false; // (e.g. ENOSYS or disabled by the administrator)
+            ringFd = static_cast<int>(fd);
+            if (!supported()) // (e.g. kernels 5.1 to 5.5: no IORING_OP_READ / IORING_OP_WRITE)
+            {
+                close(ringFd);
+                return false;
+            }
+            sqSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            cqSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            if (params.features & IORING_FEAT_SINGLE_MMAP) sqSize = cqSize = std::max(sqSize, cqSize);
+            sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+            sqRing = mmap(nullptr, sqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_SQ_RING);
+            cqRing = (params.features & IORING_FEAT_SINGLE_MMAP)? sqRing
+                   : mmap(nullptr, cqSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, IORING_OFF_CQ_RING);
+            sqes = static_cast<io_uring_sqe*>(mmap(nullptr, sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                                   ringFd, IORING_OFF_SQES));
+            wakeFd = eventfd(0, EFD_CLOEXEC);
+            if ((sqRing == MAP_FAILED) || (cqRing == MAP_FAILED) || (sqes == MAP_FAILED) || (wakeFd < 0))
+            {
+                unmapRing();
+                if (wakeFd >= 0) close(wakeFd);
+                wakeFd = -1;
+                return false;
+            }
+            auto sq = static_cast<char*>(sqRing);
+            auto cq = static_cast<char*>(cqRing);
+            sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+            sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+            sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+            sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+            cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+            cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+            cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+            cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+            capacity = params.sq_entries - 1; // one entry reserved for the wakeup read
+            toSubmit = 0;
+            return true;
+        }
+
+        bool supported() const // the opcodes in use (the probe itself requires kernel 5.6)
+        {
+            const unsigned ops = 256;
+            std::vector<char> buffer(sizeof(io_uring_probe) + ops * sizeof(io_uring_probe_op));
+            auto probe = reinterpret_cast<io_uring_probe*>(buffer.data());
+            if (syscall(__NR_io_uring_register, ringFd, IORING_REGISTER_PROBE, probe, ops) < 0) return false;
+            static const unsigned required[] = { IORING_OP_READ, IORING_OP_WRITE, IORING_OP_FSYNC, IORING_OP_ACCEPT,
+                                                 IORING_OP_ASYNC_CANCEL };
+            for (unsigned op : required)
+                if ((op > probe->last_op) || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) return false;
+            return true;
+        }
+
+        void unmapRing()
+        {
+            if (sqes && (sqes != MAP_FAILED)) munmap(sqes, sqesSize);
+            if (cqRing && (cqRing != MAP_FAILED) && (cqRing != sqRing)) munmap(cqRing, cqSize);
+            if (sqRing && (sqRing != MAP_FAILED)) munmap(sqRing, sqSize);
+            close(ringFd);
+        }
+
+        io_uring_sqe* nextEntry() // (the reaper is the only producer of the submission queue)
+        {
+            unsigned tail = *sqTail;
+            if (tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE) > sqMask) return nullptr;
+            unsigned index = tail & sqMask;
+            io_uring_sqe* entry = &sqes[index];
+            std::memset(entry, 0, sizeof(*entry));
+            sqArray[index] = index;
+            __atomic_store_n(sqTail, tail + 1, __ATOMIC_RELEASE);
+            toSubmit++;
+            return entry;
+        }
+
+        void prepare(io_uring_sqe* entry, Request& request)
+        {
+            entry->fd = request.fd;
+            entry->user_data = FirstTag + request.sequence;
+            switch (request.op)
+            {
+                case Op::Read:
+                case Op::Write:
+                    entry->opcode = request.op == Op::Read? IORING_OP_READ : IORING_OP_WRITE;
+                    entry->addr = reinterpret_cast<uint64_t>(request.data.data());
+                    entry->len = static_cast<uint32_t>(request.data.size());
+                    entry->off = static_cast<uint64_t>(request.offset); // (-1: current file position)
+                    break;
+                case Op::Fsync: // (only submitted once the previous operations are completed)
+                    entry->opcode = IORING_OP_FSYNC;
+                    break;
+                case Op::Accept:
+                    entry->opcode = IORING_OP_ACCEPT;
+                    entry->accept_flags = SOCK_CLOEXEC;
+                    break;
+            }
+        }
+
+        bool armWakeup()
+        {
+            io_uring_sqe* entry = nextEntry();
+            if (!entry) return false;
+            entry->opcode = IORING_OP_READ;
+            entry->fd = wakeFd;
+            entry->addr = reinterpret_cast<uint64_t>(&wakeCounter);
+            entry->len = sizeof(wakeCounter);
+            entry->user_data = WakeTag;
+            return true;
+        }
+
+        void reaper() // owns the ring
+        {
+            std::map<uint64_t, std::unique_ptr<Request>> inFlight; // by sequence
+            std::deque<std::unique_ptr<Request>> batch;
+            bool waking = armWakeup();
+            bool cancelled = false;
+            for (;;)
+            {
+                bool stop;
+                {
+                    std::lock_guard<std::mutex> lock(mtx);
+                    stop = stopping;
+                    while (!queue.empty() && (stop || (inFlight.size() + batch.size() < capacity))) // (stop: cancel all)
+                    {
+                        batch.push_back(std::move(queue.front()));
+                        queue.pop_front();
+                    }
+                }
+                if (stop && waking) signal(); // (the wakeup read has to complete before leaving)
+                for (; !batch.empty(); batch.pop_front())
+                {
+                    if (stop) complete(batch.front(), -ECANCELED);
+                    else
+                    {
+                        Request& request = *batch.front();
+                        bool blocked = (request.op == Op::Fsync) && !inFlight.empty(); // (all of them are previous)
+                        io_uring_sqe* entry = blocked? nullptr : nextEntry();
+                        if (!entry) break; // (retried after the next completions)
+                        prepare(entry, request);
+                        inFlight[request.sequence] = std::move(batch.front());
+                    }
+                }
+                if (stop && !cancelled) // (the requests still queued are drained on the following rounds)
+                {
+                    for (auto& op : inFlight)
+                    {
+                        io_uring_sqe* entry = nextEntry();
+                        if (!entry) break; // (very unlikely: the cancellation is best effort)
+                        entry->opcode = IORING_OP_ASYNC_CANCEL;
+                        entry->addr = FirstTag + op.first;
+                        entry->user_data = CancelTag;
+                    }
+                    cancelled = true;
+                }
+                if (stop && inFlight.empty() && !waking && batch.empty())
+                {
+                    std::lock_guard<std::mutex> lock(mtx);
+                    if (queue.empty()) return;
+                }
+                long entered = syscall(__NR_io_uring_enter, ringFd, toSubmit, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+                if (entered < 0)
+                {
+                    if ((errno != EINTR) && (errno != EAGAIN) && (errno != EBUSY)) return; // (unexpected)
+                    entered = 0;
+                }
+                toSubmit -= std::min(toSubmit, static_cast<unsigned>(entered));
+                unsigned head = *cqHead;
+                for (unsigned tail = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE); head != tail; head++)
+                {
+                    const io_uring_cqe& event = cqes[head & cqMask];
+                    if (event.user_data == WakeTag)
+                    {
+                        if (event.res < 0) // (fatal: without it the new requests would go unnoticed)
+                        {
+                            std::lock_guard<std::mutex> lock(mtx);
+                            stopping = true; // submit() refuses them and the pending ones are cancelled
+                        }
+                        waking = !stop && (event.res >= 0) && armWakeup();
+                    }
+                    else if (event.user_data != CancelTag)
+                    {
+                        auto op = inFlight.find(event.user_data - FirstTag);
+                        if (op == inFlight.end()) continue;
+                        complete(op->second, event.res);
+                        inFlight.erase(op);
+                    }
+                }
+                __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+            }
+        }
+
+        int ringFd;
+        void* sqRing;
+        void* cqRing;
+        io_uring_sqe* sqes;
+        std::size_t sqSize, cqSize, sqesSize;
+        unsigned* sqHead;
+        unsigned* sqTail;
+        unsigned sqMask;
+        unsigned* sqArray;
+        unsigned* cqHead;
+        unsigned* cqTail;
+        unsigned cqMask;
+        io_uring_cqe* cqes;
+        std::size_t capacity; // operations in flight
+        unsigned toSubmit;
+        uint64_t wakeCounter;
+
+#else
+        void reaper() {}
+#endif
+
+        bool ring; // io_uring in use (otherwise the threads fallback)
+        int wakeFd; // the reaper waits for it along with the completions
+        std::mutex mtx;
+        std::condition_variable workAvailable; // (fallback)
+        std::condition_variable barrier; // (fallback)
+        std::deque<std::unique_ptr<Request>> queue;
+        std::set<uint64_t> running; // (fallback)
+        std::atomic<bool> stopping;
+        uint64_t sequence;
+        std::vector<std::thread> workers;
+};
+
+#endif /* ACTORIO_HPP */
@@ -0,0 +1,182 @@
+// Linux epoll reactor for ActorThread active objects (https://github.com/lightful/syscpp)
+//
+//       Copyright Ciriaco Garcia de Celis 2016-2017.
+// Distributed under the Boost Software License, Version 1.0.
+//    (See accompanying file LICENSE_1_0.txt or copy at
+//          http://www.boost.org/LICENSE_1_0.txt)
+/*
+ - Publicly inherit from ActorReactor (specializing it for the derived class itself) instead of from ActorThread
+ - On the derived class make both ActorThread and ActorReactor friends (everything else can remain private)
+ - The mailboxes (eventfd), the timers (timerfd) and the watched descriptors are waited in a single epoll_wait()
+ - Use fdWatch() / fdUnwatch() from the active object to register (or modify) and remove file descriptors
+ - Implement onReadable(int) and / or onWritable(int) on the active object (level-triggered: drain them or unwatch)
+ - Requires a dedicated thread: use create() or run() but not an ActorScheduler
+ */
+#ifndef ACTORREACTOR_HPP
+#define ACTORREACTOR_HPP
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+#include <cerrno>
+#include <ctime>
+#include <system_error>
+#include <sys++/ActorThread.hpp>
+
+template <typename Runnable> class ActorReactor : public ActorThread<Runnable>
+{
+    friend ActorThread<Runnable>;
+
+    public:
+
+        typedef typename ActorThread<Runnable>::TimerClock TimerClock;
+
+    protected:
+
+        ActorReactor() : epollFd(epoll_create1(EPOLL_CLOEXEC)), wakeFd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+                         timerFd(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)), armed(false)
+        {
+            if ((epollFd < 0) || (wakeFd < 0) || (timerFd < 0)
+                || !control(EPOLL_CTL_ADD, wakeFd, EPOLLIN) || !control(EPOLL_CTL_ADD, timerFd, EPOLLIN))
+            {
+                int error = errno;
+                closeAll();
+                throw std::system_error(error, std::system_category(), "ActorReactor");
+            }
+            this->acquireDispatcher(); // onDispatching() will run the epoll loop
+        }
+
+        ~ActorReactor() { closeAll(); } // (the watched descriptors belong to the derived class)
+
+        /* methods invoked on the active object (this default implementation can be "overrided") */
+
+        void onReadable(int) {} // also on hangup or error (the subsequent read() will tell)
+        void onWritable(int) {}
+
+        /* the active object may use these methods to wait for its file descriptors */
+
+        bool fdWatch(int fd, bool readable = true, bool writable = false) // add or modify (false if failed: see errno)
+        {
+            if (fd < 0)
+            {
+                errno = EBADF;
+                return false;
+            }
+            uint32_t events = (readable? EPOLLIN | EPOLLRDHUP : 0u) | (writable? EPOLLOUT : 0u);
+            auto index = static_cast<std::size_t>(fd);
+            if (watching(fd) && control(EPOLL_CTL_MOD, fd, events)) return true;
+            if (!control(EPOLL_CTL_ADD, fd, events)) return false; // (also if closed without fdUnwatch() and reused)
+            if (index >= watched.size()) watched.resize(index + 1);
+            watched[index] = true;
+            return true;
+        }
+
+        void fdUnwatch(int fd) // before closing it (pending events of the current round are discarded as well)
+        {
+            if (!watching(fd)) return;
+            watched[static_cast<std::size_t>(fd)] = false;
+            epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+        }
+
+        bool watching(int fd) const
+        {
+            return (fd >= 0) && (static_cast<std::size_t>(fd) < watched.size()) && watched[static_cast<std::size_t>(fd)];
+        }
+
+    private:
+
+        ActorReactor& operator=(const ActorReactor&) = delete;
+        ActorReactor(const ActorReactor&) = delete;
+
+        /* ActorThread external dispatcher hooks */
+
+        void onDispatching() // the epoll loop (until the object is stopped)
+        {
+            Runnable* runnable = static_cast<Runnable*>(this);
+            this->handleActorEvents(); // (those received before)
+            epoll_event events[MaxEvents];
+            while (!this->exiting())
+            {
+                int ready = epoll_wait(epollFd, events, MaxEvents, -1);
+                if (ready < 0)
+                {
+                    if (errno == EINTR) continue;
+                    return; // (ActorThread would resume its own dispatcher)
+                }
+                bool actorEvents = false;
+                for (int i = 0; i < ready; i++)
+                {
+                    int fd = events[i].data.fd;
+                    if ((fd == wakeFd) || (fd == timerFd))
+                    {
+                        uint64_t counter; // (reset)
+                        if ((read(fd, &counter, sizeof(counter)) > 0) && (fd == timerFd)) armed = false;
+                        actorEvents = true;
+                        continue;
+                    }
+                    if ((events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) && watching(fd))
+                        runnable->onReadable(fd);
+                    if ((events[i].events & EPOLLOUT) && watching(fd)) runnable->onWritable(fd);
+                }
+                if (actorEvents) this->handleActorEvents();
+            }
+        }
+
+        void onWaitingEvents() // (invoked from other threads)
+        {
+            uint64_t one = 1;
+            if (write(wakeFd, &one, sizeof(one)) < 0) return; // (EAGAIN: the counter is already huge)
+        }
+
+        void onWaitingTimer(typename TimerClock::duration lapse)
+        {
+            auto deadline = TimerClock::now() + lapse;
+            if (armed && (deadline >= alarm)) return; // an earlier expiration will ask again (saves a system call)
+            alarm = deadline;
+            armed = true;
+            setTimer(std::max(lapse, typename TimerClock::duration(1))); // (zero would disarm it)
+        }
+
+        void onWaitingTimerCancel() // (invoked on every round without timers)
+        {
+            if (!armed) return;
+            armed = false;
+            setTimer(TimerClock::duration::zero());
+        }
+
+        void onStopping() { onWaitingEvents(); } // (the loop checks exiting())
+
+        bool control(int operation, int fd, uint32_t events)
+        {
+            epoll_event event = epoll_event();
+            event.events = events;
+            event.data.fd = fd;
+            return epoll_ctl(epollFd, operation, fd, &event) == 0;
+        }
+
+        void setTimer(typename TimerClock::duration lapse)
+        {
+            auto nsecs = std::chrono::duration_cast<std::chrono::nanoseconds>(lapse).count();
+            itimerspec spec = itimerspec();
+            spec.it_value.tv_sec = static_cast<time_t>(nsecs / 1000000000);
+            spec.it_value.tv_nsec = static_cast<long>(nsecs % 1000000000);
+            timerfd_settime(timerFd, 0, &spec, nullptr);
+        }
+
+        void closeAll()
+        {
+            for (int fd : { timerFd, wakeFd, epollFd }) if (fd >= 0) close(fd);
+        }
+
+        static const int MaxEvents = 64; // per epoll_wait()
+
+        int epollFd;
+        int wakeFd; // the mailboxes
+        int timerFd;
+        bool armed;
+        typename TimerClock::time_point alarm; // timerFd expiration
+        std::vector<bool> watched; // by descriptor
+};
+
+#endif /* ACTORREACTOR_HPP */
@@ -8,21 +8,40 @@
  - Publicly inherit from this template (specializing it for the derived class itself)
  - On the derived (active object) class everything should be private: make this base a friend
  - Instance the active object by invoking the inherited public static create() or run() methods
- - Use send() to send or move messages (of any data type) to the active object
+ - Use send() to send or move messages (of any data type) to the active object (returns false if not queued)
+ - Optionally use sendBatch() to queue a whole range of messages at once (a single enqueue and wakeup)
+ - Optionally use sendLatest() for "latest value wins" messages (replacing the undelivered one of the same key)
  - Use onMessage(AnyType&) methods to implement the messages reception on the active object
  - Optionally use a Gateway wrapper or build Channel objects instead of send()
  - Optionally override onStart() and onStop() in the active object
- - Optionally use connect() from unknown clients to bind callbacks for any data type
+ - Optionally use connect() from unknown clients to bind callbacks for any data type (or direct typed links)
  - Optionally use publish() from the active object to invoke the binded callbacks
+ - Optionally use subscribe() from clients to receive a shared immutable payload on each broadcast()
+ - Optionally use ask() from the active object to get a reply() from another through a continuation
+ - Optionally declare 'static const bool instrumented = true' in the active object to collect metrics()
+ - Optionally declare 'typedef ActorMessages<A, B, ...> messages' in the active object to dispatch without virtual calls
+ - Optionally declare 'typedef ActorMessages<A, ...> batched' and onMessages(A*, std::size_t) to receive runs of them
+ - Optionally declare 'static const unsigned priorities = N' in the active object and use sendAt<Level>() (up to 64)
  - Optionally use timerStart() / timerStop() / timerReset() from the active object
+ - Optionally pass a Settings object to create() or run() to tune the active object (e.g. pooled messages memory)
+ - Optionally enable Settings::lanes when many threads flood the same active object (a mailbox per producer)
+ - Optionally run many active objects on a shared ActorScheduler (M:N mode) instead of one thread per object
+ - Optionally pin the thread to some CPUs or a NUMA node, name it or set its stack size and policy (see Settings)
+ - Otherwise the threads are recycled among the objects created over time (see ActorRunner::recycling())
+ - Optionally let mostly idle objects hibernate: no thread until a message comes (see Settings::hibernation)
+ - Optionally (C++20) write member coroutines returning Coro which co_await ask() replies, sleepFor() or expect()
  */
 #ifndef ACTORTHREAD_HPP
 #define ACTORTHREAD_HPP
 
 #include <memory>
+#include <new>
+#include <vector>
 #include <functional>
 #include <utility>
 #include <cstddef>
+#include <cstdint>
+#include <iterator>
 #include <type_traits>
 #include <thread>
 #include <mutex>
@@ -30,445 +49,3206 @@
 #include <atomic>
 #include <chrono>
 #include <stdexcept>
+#include <algorithm>
 #include <set>
 #include <map>
-
-template <typename Runnable> class ActorThread
+#include <unordered_map>
+#include <deque>
+#include <limits>
+#include <string>
+#include <typeinfo>
+#include <system_error>
+#include <exception>
+#include <cerrno>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <climits>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <fstream>
+#endif
+#if defined(__cpp_impl_coroutine) && defined(__has_include)
+#if __has_include(<coroutine>)
+#include <coroutine>
+#include <optional>
+#define ACTORTHREAD_COROUTINES 1 // C++20 onwards (see ActorThread::Coro)
+#endif
+#endif
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#include <intrin.h>
+#endif
+
+class ActorPool // per-thread size-class freelists for the messages memory (see ActorThread::Settings::pooled)
 {
-    public:
+    struct Header // precedes every block (16 bytes keeping the payload suitably aligned)
+    {
+        ActorPool* owner; // nullptr for plain heap blocks
+        union { Header* next; std::size_t sizeClass; }; // 'next' while free (or the heap allocation), 'sizeClass' in use
+    };
 
-        typedef std::shared_ptr<Runnable> ptr;
+    public:
 
-        std::weak_ptr<Runnable> weak_from_this() const noexcept { return weak_this; } // shared_from_this() would be unsafe
+        static void* allocate(std::size_t bytes, bool pooled, std::size_t alignment = sizeof(Header))
+        {   // runs on the producer thread
+            std::size_t sizeClass = 0;
+            while ((sizeClass < Classes) && (bytes + sizeof(Header) > classBytes(sizeClass))) sizeClass++;
+            Header* block;
+            bool aligned = alignment <= sizeof(Header);
+            if (!pooled || (sizeClass == Classes) || !aligned) // too big for the freelists (or not requested)
+            {
+                std::size_t slack = aligned? 0 : alignment; // over-aligned payloads (alignas(32) and beyond)
+                auto memory = static_cast<Header*>(::operator new(bytes + sizeof(Header) + slack));
+                auto payload = reinterpret_cast<uintptr_t>(memory + 1);
+                if (!aligned) payload = (payload + alignment - 1) & ~uintptr_t(alignment - 1);
+                block = reinterpret_cast<Header*>(payload) - 1;
+                block->owner = nullptr;
+                block->next = memory;
+            }
+            else block = local().take(sizeClass);
+            return block + 1;
+        }
 
-        template <typename ... Args> static ptr create(Args&&... args) // spawn a new thread
+        static void release(void* memory) // runs on any thread (usually the consumer one)
         {
-            auto task = ptr(new Runnable(std::forward<Args>(args)...), actorThreadRecycler);
-            task->weak_this = task;
-            task->runner = std::thread(&ActorThread::dispatcher, task.get());
-            return task;
+            Header* block = static_cast<Header*>(memory) - 1;
+            ActorPool* owner = block->owner;
+            if (!owner) ::operator delete(block->next);
+            else if (owner == current()) owner->keep(block); // self-sent message (no atomics required)
+            else owner->giveBack(block); // lock-free return to the producer which allocated it
         }
 
-        template <typename ... Args> static int run(Args&&... args) // run in the calling thread (e.g. main() thread)
+    private:
+
+        enum { Classes = 4, CacheLimit = 8192 }; // blocks of 64, 128, 256 and 512 bytes (header included)
+
+        static std::size_t classBytes(std::size_t sizeClass) { return std::size_t(64) << sizeClass; }
+
+        ActorPool()
         {
-            struct ActRunTask : public Runnable { ActRunTask(Args&&... arg) : Runnable(std::forward<Args>(arg)...) {} };
-            auto task = std::make_shared<ActRunTask>(std::forward<Args>(args)...);
-            task->weak_this = task;
-            return task->dispatcher();
+            for (std::size_t i = 0; i < Classes; i++)
+            {
+                freeList[i] = nullptr;
+                cached[i] = 0;
+                returned[i].store(nullptr, std::memory_order_relaxed);
+            }
         }
 
-        template <bool HighPri = false, typename Any> inline void send(Any msg) // polymorphic message passing
+        Header* take(std::size_t sizeClass)
         {
-            post<ActorMessage<Any>, HighPri>(std::move(msg)); // gratis rvalue onwards
+            Header* block = freeList[sizeClass];
+            if (!block) block = reclaim(sizeClass);
+            if (block)
+            {
+                freeList[sizeClass] = block->next;
+                cached[sizeClass]--;
+            }
+            else // the steady state is reached when every message in flight has been allocated once
+            {
+                block = static_cast<Header*>(::operator new(classBytes(sizeClass)));
+                block->owner = this;
+            }
+            block->sizeClass = sizeClass;
+            return block;
         }
 
-        template <typename Any> using Channel = std::function<void(Any&)>;
-
-        template <typename Any, bool HighPri = false> Channel<Any> getChannel() const // build a generic movement callback
+        Header* reclaim(std::size_t sizeClass) // adopt the blocks returned by other threads (single atomic exchange)
         {
-            std::weak_ptr<ActorThread> weakBind(this->weak_from_this()); // Note:
-            return Channel<Any>([weakBind](Any& data)                    // std::bind can't store a weak_ptr
-            {                                                            // in std::function (and a shared_ptr
-                auto aliveTarget = weakBind.lock();                      // would prevent objects destruction)
-                if (aliveTarget)
-                    std::static_pointer_cast<Runnable>(aliveTarget)->template send<HighPri>(std::move(data));
-            });
+            Header* chain = returned[sizeClass].exchange(nullptr, std::memory_order_acquire);
+            while (chain)
+            {
+                Header* next = chain->next;
+                if (cached[sizeClass] < CacheLimit)
+                {
+                    chain->next = freeList[sizeClass];
+                    freeList[sizeClass] = chain;
+                    cached[sizeClass]++;
+                }
+                else ::operator delete(chain); // trim the memory retained after a burst
+                chain = next;
+            }
+            return freeList[sizeClass];
         }
 
-        template <typename Any> void connect(Channel<Any> receiver = Channel<Any>()) // bind (or unbind) a generic callback
+        void keep(Header* block)
         {
-            post<ActorCallback<Any>, true>(std::move(receiver));
+            std::size_t sizeClass = block->sizeClass;
+            if (cached[sizeClass] >= CacheLimit) ::operator delete(block);
+            else
+            {
+                block->next = freeList[sizeClass];
+                freeList[sizeClass] = block;
+                cached[sizeClass]++;
+            }
         }
 
-        template <typename Any, bool HighPri = false, typename Him> void connect(const std::weak_ptr<Him>& receiver)
+        void giveBack(Header* block)
         {
-            auto aliveTarget = receiver.lock();
-            if (aliveTarget) connect(aliveTarget->template getChannel<Any, HighPri>()); // bind another ActorThread
+            auto& stack = returned[block->sizeClass];
+            Header* top = stack.load(std::memory_order_relaxed);
+            do block->next = top; // (only the owner pops, and does it all at once, so there is no ABA problem)
+            while (!stack.compare_exchange_weak(top, block, std::memory_order_release, std::memory_order_relaxed));
         }
 
-        std::size_t pendingMessages() const // amount of undispatched messages in the active object
+        void trim() // free every cached block
         {
-            return mboxNormPri.size() + mboxHighPri.size();
+            for (std::size_t i = 0; i < Classes; i++)
+            {
+                reclaim(i);
+                while (Header* block = freeList[i])
+                {
+                    freeList[i] = block->next;
+                    ::operator delete(block);
+                }
+                cached[i] = 0;
+            }
         }
 
-        typedef std::chrono::steady_clock TimerClock;
+        struct Orphans // pools whose thread exited (the blocks still in flight keep pointing them)
+        {
+            std::mutex mtx;
+            std::vector<ActorPool*> pools;
+        };
 
-        void waitIdle(TimerClock::duration maxWait = std::chrono::seconds(1)) // blocks until there aren't pending messages
+        static Orphans& orphans()
         {
-            std::unique_lock<std::mutex> ulock(mtx);
-            if (!(mboxNormPri.empty() && mboxHighPri.empty())) idleWaiter.wait_until(ulock, TimerClock::now() + maxWait);
+            static Orphans* registry = new Orphans; // never deleted: messages could still be released at exit
+            return *registry;
         }
 
-        void stop(int code = 0) // optional call from ANOTHER thread (suffices deleting the object) or if created from run()
+        struct Lease // binds a pool to the current thread
         {
-            if (stop(false)) exitCode = code; // return code for run() function
+            Lease()
+            {
+                auto& registry = orphans();
+                std::lock_guard<std::mutex> lock(registry.mtx);
+                if (registry.pools.empty()) pool = new ActorPool;
+                else // recycle the pool of an exited thread
+                {
+                    pool = registry.pools.back();
+                    registry.pools.pop_back();
+                }
+                current() = pool;
+            }
+            ~Lease()
+            {
+                current() = nullptr;
+                pool->trim();
+                auto& registry = orphans();
+                std::lock_guard<std::mutex> lock(registry.mtx);
+                registry.pools.push_back(pool);
+            }
+            ActorPool* pool;
+        };
+
+        static ActorPool& local()
+        {
+            static thread_local Lease lease;
+            return *lease.pool;
         }
 
-        bool exiting() const // mostly to allow active objects running intensive jobs to poll for a shutdown request
+        static ActorPool*& current() // (trivially initialized: cheap to query from the consumer)
         {
-            return !dispatching;
+            static thread_local ActorPool* pool = nullptr;
+            return pool;
         }
 
-        struct Gateway // safe wrapper for instances of unknown lifecycle
+        Header* freeList[Classes]; // owner thread only
+        std::size_t cached[Classes];
+        char padding[64]; // keep apart the cache lines written by other threads
+        std::atomic<Header*> returned[Classes];
+};
+
+class ActorHistogram // lock-free log-linear histogram (single writer, any amount of concurrent readers)
+{
+    public:
+
+        static const unsigned SubBits = 2, Buckets = (64 - SubBits + 1) << SubBits; // 4 buckets per power of two
+
+        struct Snapshot
         {
-            Gateway(const std::weak_ptr<Runnable>& actorThread = ptr()) : actor(actorThread) {}
+            std::vector<uint64_t> counts; // per bucket (see floor())
+            uint64_t total;
+            uint64_t sum;
 
-            template <typename Any> inline void operator()(Any&& msg) const // handy function-like syntax
+            double mean() const { return total? static_cast<double>(sum) / static_cast<double>(total) : 0; }
+
+            uint64_t percentile(double fraction) const // (bucket floor) e.g. 0.99
             {
-                auto aliveTarget = get();
-                if (aliveTarget) aliveTarget->template send<false>(std::forward<Any>(msg));
+                auto rank = static_cast<uint64_t>(fraction * static_cast<double>(total));
+                uint64_t seen = 0;
+                for (unsigned bucket = 0; bucket < counts.size(); bucket++)
+                    if ((seen += counts[bucket]) > rank) return floor(bucket);
+                return 0;
             }
+        };
 
-            void set(const std::weak_ptr<Runnable>& actorThread) { actor = actorThread; }
+        ActorHistogram() : counts(), sum(0) {}
 
-            inline ptr get() const { return actor.lock(); }
+        void record(uint64_t value) // (no locked instructions)
+        {
+            auto& count = counts[bucket(value)];
+            count.store(count.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            sum.store(sum.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+        }
 
-            private: std::weak_ptr<Runnable> actor;
-        };
+        Snapshot snapshot() const // (not atomic as a whole)
+        {
+            Snapshot copy;
+            copy.counts.resize(Buckets);
+            copy.total = 0;
+            for (unsigned i = 0; i < Buckets; i++)
+                copy.total += copy.counts[i] = counts[i].load(std::memory_order_relaxed);
+            copy.sum = sum.load(std::memory_order_relaxed);
+            return copy;
+        }
 
-    protected:
+        static unsigned bucket(uint64_t value)
+        {
+            if (value < (1u << SubBits)) return static_cast<unsigned>(value);
+            unsigned exponent = 0;
+            for (unsigned shift = 32; shift; shift >>= 1)
+                if (value >> (exponent + shift)) exponent += shift;
+            auto sub = static_cast<unsigned>(value >> (exponent - SubBits)) & ((1u << SubBits) - 1);
+            return ((exponent - SubBits + 1) << SubBits) + sub;
+        }
 
-        ActorThread() : dispatching(true), externalDispatcher(false), detached(false), exitCode(0), mboxPaused(false) {}
+        static uint64_t floor(unsigned bucket) // lowest value of the bucket
+        {
+            if (bucket < (1u << SubBits)) return bucket;
+            unsigned exponent = (bucket >> SubBits) + SubBits - 1;
+            uint64_t mantissa = (1u << SubBits) + (bucket & ((1u << SubBits) - 1));
+            return mantissa << (exponent - SubBits);
+        }
 
-        virtual ~ActorThread() {} // messages pending to be dispatched are discarded
+    private:
 
-        /* methods invoked on the active object (this default implementation can be "overrided") */
+        std::atomic<uint64_t> counts[Buckets];
+        std::atomic<uint64_t> sum;
+};
 
-        void onStart() {}
-        void onStop() {}
+template <bool Instrumented> struct ActorStamp {}; // carried by every message (empty unless instrumented)
 
-        std::thread::id threadID() const { return id; }
+template <> struct ActorStamp<true>
+{
+    std::chrono::steady_clock::time_point posted;
+    const std::type_info* type; // payload
+    std::size_t kind; // index of the payload type
+};
 
-        /* the active object may use this family of methods to perform the callbacks onto connected clients */
+template <typename... Types> struct ActorMessages // compile-time registry of the message types of an active object
+{
+    static const std::size_t size = sizeof...(Types);
+};
 
-        template <typename Any> inline static void publish(Any msg)
-        {
-            auto& bearer = callback<Any>();
-            if (bearer) bearer(msg); // if binded with getChannel() won't call a deleted peer
-        }
+template <typename Any, typename List> struct ActorMessageCode // position in the registry (from 1 onwards, 0 if absent)
+{
+    static const std::size_t value = 0;
+};
+
+template <typename Any, typename... Rest> struct ActorMessageCode<Any, ActorMessages<Any, Rest...>>
+{
+    static const std::size_t value = 1;
+};
+
+template <typename Any, typename First, typename... Rest> struct ActorMessageCode<Any, ActorMessages<First, Rest...>>
+{
+    static const std::size_t next = ActorMessageCode<Any, ActorMessages<Rest...>>::value;
+    static const std::size_t value = next? next + 1 : 0;
+};
+
+template <bool Registered> struct ActorCode {}; // carried by every message (empty unless the registry is declared)
+
+template <> struct ActorCode<true>
+{
+    ActorCode() : code(0) {}
+    std::size_t code; // ActorMessageCode of the payload (0 for the internal messages: virtual dispatch)
+};
+
+template <bool Batched> struct ActorRun {}; // carried by every message (empty unless batched types are declared)
+
+template <> struct ActorRun<true>
+{
+    ActorRun() : run(0) {}
+    std::size_t run; // ActorMessageCode of the payload in the batched ones (0 if delivered one by one)
+};
+
+struct ActorAsk // reply path of a request sent with ask() (see reply())
+{
+    virtual ~ActorAsk() {}
+};
+
+template <typename Reply> struct ActorAskFor : public ActorAsk
+{
+    virtual bool answer(Reply&& reply) = 0; // invoked from any thread (false if the asking object is gone)
+};
+
+#ifdef ACTORTHREAD_COROUTINES
+
+class ActorFrames // coroutine frames of an active object: recycled by size and destroyed along with it (see Coro)
+{
+    struct Header // precedes every frame (16 bytes keeping it suitably aligned)
+    {
+        ActorFrames* owner;
+        union { Header* next; std::size_t bytes; }; // 'next' while free, 'bytes' while in use
+    };
 
-        template <typename Any> static Channel<Any>& callback() // callback storage (per-thread and type)
+    public:
+
+        struct Frame // base of the promise of every coroutine (linked while alive)
         {
-            static thread_local Channel<Any> bearer; // beware that this callback moves the argument
-            return bearer;
-        }
+            explicit Frame(ActorFrames& frames) : owner(frames), prev(nullptr), next(frames.live)
+            {
+                if (next) next->prev = this;
+                owner.live = this;
+            }
 
-        /* timers facility for the active object (unlimited amount: one per each "payload" instance) */
+            ~Frame()
+            {
+                if (prev) prev->next = next;
+                else owner.live = next;
+                if (next) next->prev = prev;
+            }
 
-        enum class TimerCycle { Periodic, OneShot };
+            void unhandled() // the exception which ends the coroutine
+            {
+                if (owner.resumed != handle.address()) throw; // first run: to the caller (which releases the frame)
+                error = std::current_exception(); // resumed: to the resumer (see rethrow())
+            }
 
-        template <typename Any> void timerStart(const Any& payload, TimerClock::duration lapse,
-                                                Channel<const Any> event, TimerCycle cycle = TimerCycle::OneShot)
+            void failed() { owner.failure = this; } // (suspended at its end until rethrow())
+
+            ActorFrames& owner;
+            std::coroutine_handle<> handle;
+            std::exception_ptr error; // which ended the coroutine
+            Frame* prev;
+            Frame* next;
+        };
+
+        ActorFrames() : live(nullptr), failure(nullptr), resumed(nullptr) {}
+
+        ~ActorFrames()
         {
-            std::shared_ptr<ActorAlarm<Any>> timer;
-            auto& allTimersOfThatType = timerEvents<Any>(this);
-            auto pTimer = allTimersOfThatType.find(payload);
-            if (pTimer == allTimersOfThatType.end())
+            clear();
+            for (auto& freeList : freeLists)
             {
-                timer = std::make_shared<ActorAlarm<Any>>(std::move(event), payload);
-                allTimersOfThatType.emplace(timer->payload, timer);
+                while (Header* block = freeList.second)
+                {
+                    freeList.second = block->next;
+                    ::operator delete(block);
+                }
             }
-            else // reschedule and reprogram
+        }
+
+        void* allocate(std::size_t bytes) // on the object thread (as every coroutine resumption)
+        {
+            Header*& freeList = sized(bytes);
+            Header* block = freeList;
+            if (block) freeList = block->next;
+            else // the steady state is reached when every coroutine in flight has been allocated once
             {
-                timer = pTimer->second.lock();
-                timers.erase(timer);
-                timer->event = std::move(event);
+                block = static_cast<Header*>(::operator new(bytes + sizeof(Header)));
+                block->owner = this;
             }
-            timer->lapse = lapse;
-            timer->cycle = cycle;
-            timer->reset(false);
-            timers.insert(std::move(timer));
+            block->bytes = bytes;
+            return block + 1;
         }
 
-        template <typename Any> void timerStart(const Any& payload, TimerClock::duration lapse, // invokes onTimer() methods
-                                                TimerCycle cycle = TimerCycle::OneShot)
+        void clear() // the suspended ones (never to be resumed)
         {
-            Runnable* runnable = static_cast<Runnable*>(this); // safe (a dead 'this' will not dispatch timers)
-            timerStart(payload, lapse, Channel<const Any>([runnable](const Any& p) { runnable->onTimer(p); }), cycle);
+            failure = nullptr;
+            while (live) live->handle.destroy();
         }
 
-        template <typename Any> void timerReset(const Any& payload)
+        void* resuming(void* frame) { std::swap(resumed, frame); return frame; } // (returns the previous one)
+
+        void rethrow() // the exception which has just ended a resumed coroutine (to the resumer)
         {
-            auto const& allTimersOfThatType = timerEvents<Any>(this);
-            auto pTimer = allTimersOfThatType.find(payload);
-            if (pTimer != allTimersOfThatType.end()) timerReschedule(pTimer->second.lock(), false);
+            if (!failure) return;
+            Frame* done = failure;
+            failure = nullptr;
+            auto error = done->error;
+            done->handle.destroy();
+            std::rethrow_exception(error);
         }
 
-        template <typename Any> void timerStop(const Any& payload)
+        static void release(void* frame)
         {
-            auto& allTimersOfThatType = timerEvents<Any>(this);
-            auto pTimer = allTimersOfThatType.find(payload);
-            if (pTimer != allTimersOfThatType.end())
-            {
-                auto timer = pTimer->second.lock();
-                timers.erase(timer);
-                allTimersOfThatType.erase(pTimer);
-                if (timer.use_count() > 1) timer->reset(false); // timer "touched" signaling to dispatcher
-            }
+            Header* block = static_cast<Header*>(frame) - 1;
+            Header*& freeList = block->owner->sized(block->bytes);
+            block->next = freeList;
+            freeList = block;
         }
 
-        /* the active object may throw this object while processing a message */
+    private:
 
-        struct DispatchRetry // the delivery will be retried later
+        ActorFrames& operator=(const ActorFrames&) = delete;
+        ActorFrames(const ActorFrames&) = delete;
+
+        Header*& sized(std::size_t bytes) // the frames of a coroutine function have always the same size
         {
-            DispatchRetry(TimerClock::duration waitToRetry = std::chrono::seconds(1)) : retryInterval(waitToRetry) {}
-            bool operator<(const DispatchRetry&) const { return false; } // enforce a single instance in the containers
-            TimerClock::duration retryInterval; // will be shortened on every incoming high priority message
+            for (auto& freeList : freeLists) if (freeList.first == bytes) return freeList.second;
+            freeLists.emplace_back(bytes, nullptr);
+            return freeLists.back().second;
+        }
+
+        std::vector<std::pair<std::size_t, Header*>> freeLists; // (a few sizes)
+        Frame* live;
+        Frame* failure; // see rethrow()
+        void* resumed; // the coroutine being resumed (see ActorThread::resumeFrame())
+};
+
+#endif
+
+class ActorScheduler // M:N mode: active objects multiplexed over a fixed pool of workers (see Settings::scheduler)
+{
+    public:
+
+        typedef std::chrono::steady_clock Clock;
+
+        struct Job // a schedulable active object
+        {
+            virtual ~Job() {}
+            virtual void wake() = 0; // schedule it unless already scheduled
+            virtual void resume() = 0; // run a burst of events (never concurrently for the same job)
         };
 
-        // The following methods are exclusively intended to *interleave* the ActorThread dispatcher with another
-        // external dispatcher (e.g. Asio) which will actually be the master dispatcher having the thread control:
-        //
-        // - onWaitingEvents() must be used to request the external dispatcher to invoke handleActorEvents()
-        // - onWaitingTimer() must request the external dispatcher a delayed invocation of handleActorEvents()
-        // - onWaitingTimerCancel() must request the external dispatcher to cancel any delayed invocation
-        // - onStopping() must request the external dispatcher to end (not required a synchronous completion wait)
+        explicit ActorScheduler(unsigned workers = std::thread::hardware_concurrency())
+          : core(std::make_shared<Core>(workers? workers : 1))
+        {
+            for (std::size_t i = 0; i < core->runQueues.size(); i++) threads.emplace_back(&Core::work, core, i);
+        }
 
-        void acquireDispatcher() // request ActorThread to stop dispatching and invoke onDispatching()
+        ~ActorScheduler() // the workers end even if some active object still references this scheduler
         {
-            std::lock_guard<std::mutex> lock(mtx);
-            externalDispatcher = true;
-            messageWaiter.notify_one();
+            {
+                std::lock_guard<std::mutex> lock(core->mtx);
+                core->running = false;
+                core->wakeup.notify_all();
+            }
+            for (auto& worker : threads)
+                if (worker.get_id() != std::this_thread::get_id()) worker.join();
+                else worker.detach(); // last reference dropped from a worker (it holds its own reference to 'core')
         }
 
-        void onDispatching() {} // run the external dispatcher from here (in case it exits, ActorThread resumes again)
+        std::size_t workers() const { return threads.size(); }
 
-        void onWaitingEvents() {} // invoked from another threads (new messages coming)
-        void onWaitingTimer(TimerClock::duration); // invoked from dispatcher thread (there is only a single timer)
-        void onWaitingTimerCancel(); // invoked from dispatcher thread (will come even if the timer was not in use)
-        void onStopping() {} // invoked from another threads (mandatory handling: the object could be about to be deleted)
+        void submit(std::weak_ptr<Job> job) { core->submit(std::move(job)); } // weak: jobs never delay a deletion
 
-        void handleActorEvents() // this must be invoked from the external dispatcher as specified above
-        {
-            auto status = eventsLoop();
-            if (status.first)
-                static_cast<Runnable*>(this)->onWaitingTimer(status.second);
-            else
-                static_cast<Runnable*>(this)->onWaitingTimerCancel();
-        }
+        void wakeAt(std::weak_ptr<Job> job, Clock::time_point deadline) { core->wakeAt(std::move(job), deadline); }
+
+        static bool onWorker() { return Core::current() != nullptr; } // invoked from any scheduler worker thread?
 
     private:
 
-        ActorThread& operator=(const ActorThread&) = delete;
-        ActorThread(const ActorThread&) = delete;
+        ActorScheduler& operator=(const ActorScheduler&) = delete;
+        ActorScheduler(const ActorScheduler&) = delete;
 
-        template <typename Item> class ActorQueue // FIFO (based on the MPSC queue at https://github.com/mstump/queues)
+        struct Core
         {
-            template <typename T> using Aligned = typename std::aligned_storage<sizeof(T),std::alignment_of<T>::value>::type;
-
-            public:
+            struct RunQueue // one per worker (others steal from its back when idle)
+            {
+                std::mutex mtx;
+                std::deque<std::weak_ptr<Job>> jobs;
+                char padding[64];
+            };
 
-                struct Linked { std::atomic<Item*> next; };
+            Core(unsigned workers) : runQueues(workers), queued(0), sleepers(0), next(0), running(true),
+                                     nextAlarm(std::numeric_limits<Clock::rep>::max()) {}
 
-                ActorQueue() : head(reinterpret_cast<Item*>(new Aligned<Item>)), // dummy transient placeholder
-                               tail(head.load(std::memory_order_relaxed)),
-                               count(0),
-                               lastFront(nullptr),
-                               prevFront(tail.load(std::memory_order_relaxed))
+            void submit(std::weak_ptr<Job>&& job)
+            {
+                std::size_t index = (current() == this)? worker() : next++ % runQueues.size();
                 {
-                    prevFront->next.store(nullptr, std::memory_order_relaxed);
+                    std::lock_guard<std::mutex> lock(runQueues[index].mtx);
+                    runQueues[index].jobs.push_back(std::move(job));
                 }
-
-                void clear() { while (front()) pop_front(); }
-
-                ~ActorQueue()
+                queued.fetch_add(1); // (sequentially consistent with the sleepers accounting)
+                if (sleepers.load())
                 {
-                    clear();
-                    ::operator delete(head.load(std::memory_order_relaxed)); // also suitable for a dummy instance
+                    std::lock_guard<std::mutex> lock(mtx);
+                    wakeup.notify_one(); // an idle worker will steal it
                 }
+            }
 
-                template <typename Linkable> std::size_t push_back(Linkable* item) // e.g. any type derived from 'Linked'
+            void wakeAt(std::weak_ptr<Job>&& job, Clock::time_point deadline)
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                alarms.emplace(deadline, std::move(job));
+                if (deadline.time_since_epoch().count() < nextAlarm.load(std::memory_order_relaxed))
                 {
-                    item->next.store(nullptr, std::memory_order_relaxed);
-                    Item* back = head.exchange(item, std::memory_order_acq_rel);
-                    back->next.store(item, std::memory_order_release);
-                    return count.fetch_add(1, std::memory_order_release); // amount of queued items minus 1
+                    nextAlarm.store(deadline.time_since_epoch().count(), std::memory_order_relaxed);
+                    wakeup.notify_one(); // a sleeping worker could need an earlier wakeup
                 }
+            }
 
-                inline Item* front() // returns nullptr if empty (must be always invoked just before pop_front())
+            bool take(std::size_t index, std::weak_ptr<Job>& job)
+            {
+                if (!queued.load(std::memory_order_relaxed)) return false;
+                for (std::size_t i = 0; i < runQueues.size(); i++)
                 {
-                    return lastFront = prevFront->next.load(std::memory_order_acquire);
-                }
+                    auto& runQueue = runQueues[(index + i) % runQueues.size()];
+                    std::lock_guard<std::mutex> lock(runQueue.mtx);
+                    if (runQueue.jobs.empty()) continue;
+                    if (i == 0) // own queue: FIFO
+                    {
+                        job = std::move(runQueue.jobs.front());
+                        runQueue.jobs.pop_front();
+                    }
+                    else // steal the most recent job
+                    {
+                        job = std::move(runQueue.jobs.back());
+                        runQueue.jobs.pop_back();
+                    }
+                    queued.fetch_sub(1, std::memory_order_relaxed);
+                    return true;
+                }
+                return false;
+            }
 
-                void pop_front() // also destroys and ultimately deletes the item
+            void collectAlarms(std::vector<std::weak_ptr<Job>>& due) // requires 'mtx' locked
+            {
+                auto now = Clock::now();
+                while (!alarms.empty() && (alarms.begin()->first <= now))
                 {
-                    count.fetch_sub(1, std::memory_order_release);
-                    tail.store(lastFront, std::memory_order_release);
-                    lastFront->~Item(); // (atomic destructor is trivial) memory deletion is actually deferred one step behind
-                    ::operator delete(prevFront); // delete the *previous* item memory no longer needed
-                    prevFront = lastFront;
+                    due.push_back(std::move(alarms.begin()->second));
+                    alarms.erase(alarms.begin());
+                }
+                nextAlarm.store(alarms.empty()? std::numeric_limits<Clock::rep>::max()
+                                              : alarms.begin()->first.time_since_epoch().count(),
+                                std::memory_order_relaxed);
+            }
+
+            static void wake(std::vector<std::weak_ptr<Job>>& due)
+            {
+                for (auto& job : due)
+                {
+                    auto alive = job.lock();
+                    if (alive) alive->wake();
                 }
+                due.clear();
+            }
+
+            void work(std::size_t index) // the worker thread
+            {
+                current() = this;
+                worker() = index;
+                std::weak_ptr<Job> job;
+                std::vector<std::weak_ptr<Job>> due;
+                while (running.load(std::memory_order_relaxed))
+                {
+                    if (take(index, job))
+                    {
+                        auto alive = job.lock();
+                        job.reset();
+                        if (alive) alive->resume(); // (the job could be deleted just afterwards from this thread)
+                        if (nextAlarm.load(std::memory_order_relaxed) > Clock::now().time_since_epoch().count())
+                            continue; // keep an eye on the alarms even under full load
+                    }
+                    std::unique_lock<std::mutex> ulock(mtx);
+                    collectAlarms(due);
+                    if (!due.empty())
+                    {
+                        ulock.unlock();
+                        wake(due);
+                        continue;
+                    }
+                    if (!running) break;
+                    sleepers.fetch_add(1);
+                    if (!queued.load()) // otherwise a submit() could have missed this sleeper
+                    {
+                        if (alarms.empty()) wakeup.wait(ulock);
+                        else
+                        {
+                            auto deadline = alarms.begin()->first; // (another worker may erase it meanwhile)
+                            wakeup.wait_until(ulock, deadline);
+                        }
+                    }
+                    sleepers.fetch_sub(1);
+                }
+                current() = nullptr;
+            }
 
-                inline std::size_t size() const { return count.load(std::memory_order_acquire); }
+            static Core*& current() { static thread_local Core* core = nullptr; return core; }
+            static std::size_t& worker() { static thread_local std::size_t index = 0; return index; }
+
+            std::vector<RunQueue> runQueues;
+            std::atomic<std::size_t> queued;
+            std::atomic<unsigned> sleepers;
+            std::atomic<std::size_t> next;
+            std::atomic<bool> running;
+            std::atomic<Clock::rep> nextAlarm; // earliest alarm (quick check without locking)
+            std::mutex mtx;
+            std::condition_variable wakeup;
+            std::multimap<Clock::time_point, std::weak_ptr<Job>> alarms; // delayed wakeups (timers)
+        };
 
-                inline bool empty() const { return !size(); }
+        std::shared_ptr<Core> core;
+        std::vector<std::thread> threads;
+};
+
+template <typename Runnable> class ActorThread;
+
+class ActorRunner // the dedicated thread of an active object (a pthread on Linux to apply the Settings attributes)
+{
+    struct Run // of an object on a recycled thread
+    {
+        Run() : finished(false) {}
+        std::mutex mtx;
+        std::condition_variable done;
+        bool finished;
+    };
+
+    public:
+
+        ActorRunner() : running(false) {}
+
+        static void recycling(std::size_t parked, std::chrono::steady_clock::duration linger)
+        {   // threads kept after their object ends (0: none) and how long each one waits for another object
+            auto& recycler = Recycler::instance();
+            std::lock_guard<std::mutex> lock(recycler.mtx);
+            recycler.limit = parked;
+            recycler.linger = linger;
+        }
+
+        template <void (*Entry)(void*)> void start(void* arg, const std::vector<unsigned>& cpus, std::size_t stackSize,
+                                                  int policy, int priority, int node, const std::string& name)
+        {   // policy / node -1: inherited (throws std::system_error if the attributes are refused)
+            if (cpus.empty() && !stackSize && (policy < 0) && (node < 0) && name.empty()) // (a recycled thread keeps none)
+            {
+                auto run = std::make_shared<Run>();
+                Recycler::instance().assign(Entry, arg, run);
+                recycled = std::move(run);
+                running = true;
+                return;
+            }
+#ifdef __linux__
+            pthread_attr_t attr;
+            pthread_attr_init(&attr);
+            int error = 0;
+            auto minimum = static_cast<std::size_t>(PTHREAD_STACK_MIN);
+            if (stackSize) error = pthread_attr_setstacksize(&attr, std::max(stackSize, minimum));
+            if (!error && !cpus.empty())
+            {
+                cpu_set_t set;
+                CPU_ZERO(&set);
+                for (unsigned cpu : cpus) if (cpu < CPU_SETSIZE) CPU_SET(cpu, &set);
+                error = pthread_attr_setaffinity_np(&attr, sizeof(set), &set);
+            }
+            sched_param param = sched_param();
+            param.sched_priority = priority;
+            bool explicitSched = (policy == SCHED_OTHER) || (policy == SCHED_FIFO) || (policy == SCHED_RR);
+            if (!error && explicitSched)
+            {
+                error = pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+                if (!error) error = pthread_attr_setschedpolicy(&attr, policy);
+                if (!error) error = pthread_attr_setschedparam(&attr, &param);
+            }
+            Setup setup(arg, explicitSched? -1 : policy, param, node); // (applied by the thread itself before Entry)
+            bool checked = (setup.policy >= 0) || (node >= 0);
+            if (!error) error = checked? pthread_create(&handle, &attr, &ActorRunner::prepared<Entry>, &setup)
+                                       : pthread_create(&handle, &attr, &ActorRunner::trampoline<Entry>, arg);
+            pthread_attr_destroy(&attr);
+            if (!error && checked)
+            {
+                std::unique_lock<std::mutex> lock(setup.mtx);
+                setup.done.wait(lock, [&setup] { return setup.applied; });
+                error = setup.error;
+                lock.unlock();
+                if (error) pthread_join(handle, nullptr); // (it has returned without invoking Entry)
+            }
+            if (error) throw std::system_error(error, std::system_category(), "ActorThread");
+            if (!name.empty()) pthread_setname_np(handle, name.substr(0, 15).c_str()); // (the kernel limit)
+#else
+            (void) cpus; (void) stackSize; (void) policy; (void) priority; (void) node; (void) name; // (not supported)
+            thread = std::thread(Entry, arg);
+#endif
+            running = true;
+        }
+
+        bool joinable() const { return running; }
+
+        bool current() const // invoked from the thread itself?
+        {
+            if (recycled) return recycled.get() == Recycler::running();
+#ifdef __linux__
+            return running && pthread_equal(handle, pthread_self());
+#else
+            return running && (thread.get_id() == std::this_thread::get_id());
+#endif
+        }
+
+        void join() // (a recycled thread just ends running the object)
+        {
+            running = false;
+            if (recycled)
+            {
+                std::unique_lock<std::mutex> lock(recycled->mtx);
+                recycled->done.wait(lock, [this] { return recycled->finished; });
+                lock.unlock();
+                recycled.reset();
+                return;
+            }
+#ifdef __linux__
+            pthread_join(handle, nullptr);
+#else
+            thread.join();
+#endif
+        }
+
+        void detach()
+        {
+            running = false;
+            if (recycled)
+            {
+                recycled.reset();
+                return;
+            }
+#ifdef __linux__
+            pthread_detach(handle);
+#else
+            thread.detach();
+#endif
+        }
+
+        static std::vector<unsigned> nodeCpus(int node) // of a NUMA node (empty if unknown)
+        {
+            std::vector<unsigned> cpus;
+#ifdef __linux__
+            std::ifstream list("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist"); // e.g. "0-3,8-11"
+            unsigned first, last;
+            while (list >> first)
+            {
+                last = first;
+                if ((list.peek() == '-') && !(list.ignore() >> last)) break;
+                while (first <= last) cpus.push_back(first++);
+                if (list.peek() == ',') list.ignore();
+            }
+#else
+            (void) node;
+#endif
+            return cpus;
+        }
+
+        static int preferNode(int node) // the memory allocated from now on by the calling thread (0 or errno)
+        {
+#ifdef __linux__
+            unsigned long mask[16] = {}; // (up to 1024 nodes)
+            const std::size_t bits = 8 * sizeof(unsigned long);
+            if ((node < 0) || (static_cast<std::size_t>(node) >= 16 * bits)) return EINVAL;
+            mask[static_cast<std::size_t>(node) / bits] = 1ul << (static_cast<std::size_t>(node) % bits);
+            return (syscall(SYS_set_mempolicy, 1 /* MPOL_PREFERRED */, mask, 16 * bits) == 0)? 0 : errno;
+#else
+            (void) node;
+            return ENOSYS;
+#endif
+        }
+
+    private:
+
+        ActorRunner& operator=(const ActorRunner&) = delete;
+        ActorRunner(const ActorRunner&) = delete;
+
+        class Recycler // parked threads reused by start() (each one still runs a single object at a time)
+        {
+            struct Parked
+            {
+                Parked() : entry(nullptr), arg(nullptr) {}
+                std::condition_variable wakeup;
+                void (*entry)(void*);
+                void* arg;
+                std::shared_ptr<Run> run;
+            };
+
+            public:
+
+                static Recycler& instance()
+                {
+                    static Recycler* recycler = new Recycler; // never deleted: parked threads may outlive main()
+                    return *recycler;
+                }
+
+                static Run*& running() // the object run by the calling thread
+                {
+                    static thread_local Run* run = nullptr;
+                    return run;
+                }
+
+                void assign(void (*entry)(void*), void* arg, const std::shared_ptr<Run>& run)
+                {
+                    {
+                        std::lock_guard<std::mutex> lock(mtx);
+                        if (!idle.empty()) // the latest parked one (the warmest caches)
+                        {
+                            Parked* parked = idle.back();
+                            idle.pop_back();
+                            parked->entry = entry;
+                            parked->arg = arg;
+                            parked->run = run;
+                            parked->wakeup.notify_one();
+                            return;
+                        }
+                    }
+                    std::thread(&Recycler::work, this, entry, arg, run).detach();
+                }
+
+                std::mutex mtx;
+                std::size_t limit;
+                std::chrono::steady_clock::duration linger;
 
             private:
 
-                std::atomic<Item*> head; // the stored objects hold the linked list pointers (single memory allocation)
-                std::atomic<Item*> tail;
-                std::atomic<std::size_t> count;
-                Item* lastFront;
-                Item* prevFront;
+                Recycler() : limit(1024), linger(std::chrono::milliseconds(250)) {}
+
+                void work(void (*entry)(void*), void* arg, std::shared_ptr<Run> run)
+                {
+                    Parked parked;
+                    for (;;)
+                    {
+                        running() = run.get();
+                        entry(arg); // (a detached object deletes itself before returning)
+                        running() = nullptr;
+                        {
+                            std::lock_guard<std::mutex> lock(run->mtx);
+                            run->finished = true;
+                            run->done.notify_all();
+                        }
+                        run.reset();
+                        std::unique_lock<std::mutex> lock(mtx);
+                        if (idle.size() >= limit) return;
+                        idle.push_back(&parked);
+                        if (!parked.wakeup.wait_for(lock, linger, [&parked] { return parked.run != nullptr; }))
+                        {
+                            idle.erase(std::find(idle.begin(), idle.end(), &parked));
+                            return;
+                        }
+                        entry = parked.entry;
+                        arg = parked.arg;
+                        run = std::move(parked.run);
+                    }
+                }
+
+                std::vector<Parked*> idle;
+        };
+
+        std::shared_ptr<Run> recycled; // (instead of a thread of its own)
+
+#ifdef __linux__
+        template <void (*Entry)(void*)> static void* trampoline(void* arg)
+        {
+            Entry(arg);
+            return nullptr;
+        }
+
+        struct Setup // what pthread attributes can't apply (reported back to start() before running the object)
+        {
+            Setup(void* argument, int schedPolicy, const sched_param& schedParam, int numaNode)
+              : arg(argument), policy(schedPolicy), param(schedParam), node(numaNode), error(0), applied(false) {}
+            void* arg;
+            int policy; // SCHED_BATCH / SCHED_IDLE (unprivileged ones)
+            sched_param param;
+            int node; // preferred for the memory allocations
+            std::mutex mtx;
+            std::condition_variable done;
+            int error;
+            bool applied;
+        };
+
+        template <void (*Entry)(void*)> static void* prepared(void* arg)
+        {
+            auto& setup = *static_cast<Setup*>(arg); // (lives on the stack of start() only until notified)
+            void* entryArg = setup.arg;
+            int error = 0;
+            if (setup.policy >= 0) error = pthread_setschedparam(pthread_self(), setup.policy, &setup.param);
+            if (!error && (setup.node >= 0)) error = preferNode(setup.node); // (and the pool of messages)
+            {
+                std::lock_guard<std::mutex> lock(setup.mtx);
+                setup.error = error;
+                setup.applied = true;
+                setup.done.notify_one();
+            }
+            if (!error) Entry(entryArg);
+            return nullptr;
+        }
+
+        pthread_t handle;
+#else
+        std::thread thread;
+#endif
+        bool running;
+};
+
+class ActorAnchor // lifetime guard of an active object shared with its direct links (see ActorLink)
+{
+    public:
+
+        ActorAnchor(void* object) : target(object)
+        {
+            for (auto& stripe : stripes) stripe.visitors.store(0, std::memory_order_relaxed);
+        }
+
+        class Visit // the object can't be deleted during a visit
+        {
+            public:
+                Visit(ActorAnchor& guard) : visitors(guard.stripes[stripe()].visitors)
+                {
+                    visitors.fetch_add(1); // (sequentially consistent with the target reset)
+                    target = guard.target.load();
+                }
+                ~Visit() { visitors.fetch_sub(1, std::memory_order_release); }
+                void* target; // nullptr if already deleted
+            private:
+                std::atomic<unsigned>& visitors;
+        };
+
+        bool alive() const { return target.load(std::memory_order_relaxed) != nullptr; }
+
+        void release() // from the object destructor: waits for the current visitors
+        {
+            target.store(nullptr);
+            for (auto& stripe : stripes)
+                while (stripe.visitors.load(std::memory_order_acquire)) std::this_thread::yield();
+        }
+
+    private:
+
+        enum { Stripes = 16 };
+
+        struct Stripe // visitors counter written by a few threads only (in its own cache line)
+        {
+            std::atomic<unsigned> visitors;
+            char padding[64 - sizeof(std::atomic<unsigned>)];
+        };
+
+        static std::size_t stripe() // of the calling thread (not shared with others unless more than Stripes visit)
+        {
+            static std::atomic<std::size_t> threads(0);
+            static thread_local std::size_t index = threads.fetch_add(1, std::memory_order_relaxed) % Stripes;
+            return index;
+        }
+
+        std::atomic<void*> target; // (read-mostly)
+        char padding[64];
+        Stripe stripes[Stripes];
+};
+
+template <typename Any> class ActorLink // typed direct channel into a mailbox (see ActorThread::getLink())
+{
+    public:
+
+        ActorLink() : deliver(nullptr) {}
+
+        explicit operator bool() const { return deliver != nullptr; }
+
+        bool expired() const { return !anchor || !anchor->alive(); } // the target was deleted (or never bound)
+
+        bool operator()(Any& data) const // moves the argument (returns false if not queued or the target is gone)
+        {
+            if (!anchor) return false; // (never bound)
+            ActorAnchor::Visit visit(*anchor); // no weak_ptr::lock() nor std::function (the same for any target)
+            return visit.target && deliver(visit.target, data);
+        }
+
+    private:
+
+        template <typename> friend class ActorThread;
+        ActorLink(std::shared_ptr<ActorAnchor>&& guard, bool (*post)(void*, Any&))
+          : anchor(std::move(guard)), deliver(post) {}
+
+        std::shared_ptr<ActorAnchor> anchor;
+        bool (*deliver)(void*, Any&);
+};
+
+template <typename Runnable> class ActorThread
+{
+    public:
+
+        typedef std::shared_ptr<Runnable> ptr;
+
+        typedef std::chrono::steady_clock TimerClock;
+
+        std::weak_ptr<Runnable> weak_from_this() const noexcept { return weak_this; } // shared_from_this() would be unsafe
+
+        enum class Overflow // policy of a bounded mailbox when full (only applies to normal priority messages)
+        {
+            Block,      // send() waits for room (but fails from the active object itself to avoid a deadlock)
+            DropOldest, // the oldest undelivered message is discarded
+            DropNewest, // the message being sent is discarded (send() returns false and droppedMessages() counts it)
+            Fail        // send() returns false (without counting it)
         };
 
-    protected:
+        enum class ThreadPolicy { Inherited, Other, Fifo, RoundRobin, Batch, Idle }; // see Settings::policy
+
+        struct Settings // optional tuning of the active object (see create() and run())
+        {
+            Settings() : pooled(false), capacity(0), overflow(Overflow::Block), timerTick(TimerClock::duration::zero()),
+                         spinLoops(0), yieldLoops(0), lanes(false), burst(64), highPriRatio(0),
+                         numaNode(-1), stackSize(0), policy(ThreadPolicy::Inherited), priority(0),
+                         hibernation(TimerClock::duration::zero()) {}
+            bool pooled; // recycle the messages memory through per-thread freelists (no heap calls in steady state)
+            std::size_t capacity; // maximum amount of pending messages (0 = unbounded) approximate with many producers
+            Overflow overflow;
+            std::shared_ptr<ActorScheduler> scheduler; // M:N mode: run on its workers instead of a dedicated thread
+            TimerClock::duration timerTick; // if not zero: O(1) timers on a timing wheel (deadlines rounded up to ticks)
+            unsigned spinLoops; // when idle, busy-wait this many iterations (with a CPU pause hint) and then
+            unsigned yieldLoops; // yield the CPU this many times before sleeping (latency versus wasted CPU)
+            bool lanes; // per producer thread mailboxes (small messages stored inline) unless bounded (capacity)
+            unsigned burst; // messages dispatched in a row before checking the timers (or yielding the thread / worker)
+            unsigned highPriRatio; // if not zero: a normal priority message is let in after this many high priority ones
+            // attributes of the thread spawned by create() (Linux only, ignored under a scheduler):
+            std::vector<unsigned> cpus; // pinned to these CPUs (e.g. those sharing a cache with the peer objects)
+            int numaNode; // if not negative: on its CPUs (unless 'cpus' are given) preferring its memory
+            std::size_t stackSize; // 0 = the system default
+            std::string name; // (up to 15 characters) shown by top, ps, gdb...
+            ThreadPolicy policy; // the real-time ones (Fifo, RoundRobin) usually require privileges
+            int priority; // within the policy (e.g. 1 to 99 for Fifo and RoundRobin, 0 for the others)
+            // if not zero: create() defers the thread until the first message, and the thread is released once idle
+            TimerClock::duration hibernation; // this long (no messages nor timers) until the next message arrives
+        };
+
+        template <typename ... Args> static ptr create(Args&&... args) // spawn a new thread
+        {
+            return create(Settings(), std::forward<Args>(args)...);
+        }
+
+        template <typename ... Args> static ptr create(Settings settings, Args&&... args)
+        {
+            auto task = ptr(new Runnable(std::forward<Args>(args)...), actorThreadRecycler);
+            task->weak_this = task;
+            task->configure(settings);
+            if (!task->scheduler)
+            {
+                if (task->hibernation == TimerClock::duration::zero()) task->spawn();
+                else
+                {
+                    task->dormant = true; // (the first message will spawn it)
+                    task->parked.store(true, std::memory_order_relaxed);
+                }
+            }
+            else
+            {
+                task->weak_job = std::shared_ptr<ActorScheduler::Job>(task, &task->job); // (aliasing constructor)
+                task->wake(); // onStart() will be invoked from a worker
+            }
+            return task;
+        }
+
+        template <typename ... Args> static int run(Args&&... args) // run in the calling thread (e.g. main() thread)
+        {
+            return run(Settings(), std::forward<Args>(args)...);
+        }
+
+        template <typename ... Args> static int run(Settings settings, Args&&... args)
+        {
+            struct ActRunTask : public Runnable { ActRunTask(Args&&... arg) : Runnable(std::forward<Args>(arg)...) {} };
+            auto task = std::make_shared<ActRunTask>(std::forward<Args>(args)...);
+            task->weak_this = task;
+            settings.scheduler.reset(); // the calling thread is always used
+            settings.hibernation = TimerClock::duration::zero();
+            task->configure(settings);
+            return task->dispatcher();
+        }
+
+        template <bool HighPri = false, typename Any> inline bool send(Any msg) // polymorphic message passing
+        {
+            return post<ActorMessage<Any>, HighPri? topPriority() : 0>(std::move(msg)); // gratis rvalue onwards
+        }
+
+        template <bool HighPri = false, typename Iterator> std::size_t sendBatch(Iterator first, Iterator last)
+        {   // copies the range elements (use std::make_move_iterator to move them) returning the amount queued
+            typedef typename std::iterator_traits<Iterator>::value_type Any;
+            return postBatch<ActorMessage<Any>, HighPri? topPriority() : 0, Any>(first, last);
+        }
+
+        template <bool HighPri = false, typename Key, typename Any> bool sendLatest(const Key& key, Any msg)
+        {   // replaces in place the undelivered message of the same type and key (if any) instead of queuing another
+            return postLatest<HighPri? topPriority() : 0>(key, std::move(msg));
+        }
+
+        template <unsigned Priority, typename Any> inline bool sendAt(Any msg) // 0 is send() and the highest send<true>()
+        {
+            static_assert(Priority < Runnable::priorities, "priority level not declared (see 'priorities')");
+            return post<ActorMessage<Any>, Priority>(std::move(msg));
+        }
+
+        template <unsigned Priority, typename Iterator> std::size_t sendBatchAt(Iterator first, Iterator last)
+        {
+            static_assert(Priority < Runnable::priorities, "priority level not declared (see 'priorities')");
+            typedef typename std::iterator_traits<Iterator>::value_type Any;
+            return postBatch<ActorMessage<Any>, Priority, Any>(first, last);
+        }
+
+        template <typename Any> using Channel = std::function<void(Any&)>;
+
+        template <typename Any, bool HighPri = false> Channel<Any> getChannel() const // build a generic movement callback
+        {
+            std::weak_ptr<ActorThread> weakBind(this->weak_from_this()); // Note:
+            return Channel<Any>([weakBind](Any& data)                    // std::bind can't store a weak_ptr
+            {                                                            // in std::function (and a shared_ptr
+                auto aliveTarget = weakBind.lock();                      // would prevent objects destruction)
+                if (aliveTarget)
+                    std::static_pointer_cast<Runnable>(aliveTarget)->template send<HighPri>(std::move(data));
+            });
+        }
+
+        template <typename Any, bool HighPri = false> ActorLink<Any> getLink() const // faster than getChannel()
+        {
+            auto self = const_cast<ActorThread*>(this);
+            return ActorLink<Any>(self->anchored(), &ActorThread::template postLinked<Any, HighPri>);
+        }
+
+        template <typename Any> void connect(Channel<Any> receiver = Channel<Any>()) // bind (or unbind) a generic callback
+        {
+            post<ActorCallback<Any>, topPriority()>(std::move(receiver));
+        }
+
+        template <typename Any> void connect(ActorLink<Any> receiver) // bind (or unbind) a direct link
+        {
+            post<ActorLinker<Any>, topPriority()>(std::move(receiver));
+        }
+
+        template <typename Any, bool HighPri = false, typename Him> void connect(const std::weak_ptr<Him>& receiver)
+        {
+            auto aliveTarget = receiver.lock();
+            if (aliveTarget) connect(aliveTarget->template getLink<Any, HighPri>()); // bind another ActorThread
+        }
+
+        template <typename Any> using Shared = std::shared_ptr<const Any>; // immutable payload of a broadcast()
+
+        template <typename Any> void subscribe(ActorLink<Shared<Any>> receiver) // append a subscriber to a topic
+        {
+            if (receiver) post<ActorSubscriber<Any>, topPriority()>(std::move(receiver), true);
+        }
+
+        template <typename Any, bool HighPri = false, typename Him> void subscribe(const std::weak_ptr<Him>& receiver)
+        {   // receiver->onMessage(std::shared_ptr<const Any>&) will be invoked
+            auto aliveTarget = receiver.lock();
+            if (aliveTarget) subscribe<Any>(aliveTarget->template getLink<Shared<Any>, HighPri>());
+        }
+
+        template <typename Any, typename Him> void unsubscribe(const std::weak_ptr<Him>& receiver) // (not required
+        {                                                                                        // for deleted ones)
+            auto aliveTarget = receiver.lock();
+            if (aliveTarget) post<ActorSubscriber<Any>, topPriority()>(aliveTarget->template getLink<Shared<Any>>(), false);
+        }
+
+        std::size_t pendingMessages() const // undispatched messages, including the one being handled (if any)
+        {   // exact from its own thread (an approximate snapshot from others: the consumer publishes its progress lazily)
+            bool owner = (current() == this);
+            std::size_t queued = normalMessages(owner);
+            for (unsigned level = 1; level < Runnable::priorities; level++) queued += mboxAt(level).size(owner);
+            if (lanesUsed.load(std::memory_order_relaxed))
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                queued += laneMessages(owner);
+            }
+            return queued;
+        }
+
+        std::size_t droppedMessages() const // discarded by the Overflow::DropOldest and Overflow::DropNewest policies
+        {
+            return dropped.load(std::memory_order_relaxed);
+        }
+
+        struct Metrics // collected when the active object declares 'static const bool instrumented = true'
+        {
+            struct Messages
+            {
+                std::string type; // as given by typeid().name()
+                uint64_t delivered;
+                ActorHistogram::Snapshot dwell; // nanoseconds queued
+                ActorHistogram::Snapshot handling; // nanoseconds inside onMessage()
+            };
+            std::size_t pending;
+            uint64_t wakeups; // after sleeping
+            uint64_t bursts; // uninterrupted dispatch rounds of messages
+            uint64_t timerFires;
+            std::vector<Messages> messages; // per payload type
+        };
+
+        Metrics metrics() const // snapshot readable from any thread (without stopping the active object)
+        {
+            Metrics snapshot;
+            snapshot.pending = pendingMessages();
+            snapshot.wakeups = wakeups.load(std::memory_order_relaxed);
+            snapshot.bursts = bursts.load(std::memory_order_relaxed);
+            snapshot.timerFires = timerFires.load(std::memory_order_relaxed);
+            for (auto stats = typeMetrics.load(std::memory_order_acquire); stats; stats = stats->next)
+            {
+                typename Metrics::Messages item;
+                item.type = stats->type;
+                item.delivered = stats->delivered.load(std::memory_order_relaxed);
+                item.dwell = stats->dwell.snapshot();
+                item.handling = stats->handling.snapshot();
+                snapshot.messages.push_back(std::move(item));
+            }
+            return snapshot;
+        }
+
+        void waitIdle(TimerClock::duration maxWait = std::chrono::seconds(1)) // blocks until there aren't pending messages
+        {
+            std::unique_lock<std::mutex> ulock(mtx);
+            if (!(mboxNormPri.empty() && !levelsPending.load(std::memory_order_acquire) && !laneMessages()))
+                idleWaiter.wait_until(ulock, TimerClock::now() + maxWait);
+        }
+
+        void stop(int code = 0) // optional call from ANOTHER thread (suffices deleting the object) or if created from run()
+        {
+            if (stop(false)) exitCode = code; // return code for run() function
+        }
+
+        bool exiting() const // mostly to allow active objects running intensive jobs to poll for a shutdown request
+        {
+            return !dispatching;
+        }
+
+        struct Gateway // safe wrapper for instances of unknown lifecycle
+        {
+            Gateway(const std::weak_ptr<Runnable>& actorThread = ptr()) : actor(actorThread) {}
+
+            template <typename Any> inline bool operator()(Any&& msg) const // handy function-like syntax
+            {
+                auto aliveTarget = get();
+                return aliveTarget && aliveTarget->template send<false>(std::forward<Any>(msg));
+            }
+
+            void set(const std::weak_ptr<Runnable>& actorThread) { actor = actorThread; }
+
+            inline ptr get() const { return actor.lock(); }
+
+            private: std::weak_ptr<Runnable> actor;
+        };
+
+    private:
+
+        template <typename Reply> struct ActorPending; // state of an ask() (declared before its completion handle)
+
+    protected:
+
+        ActorThread() : dispatching(true), externalDispatcher(false), detached(false), exitCode(0),
+                        pooled(false), capacity(0), overflow(Overflow::Block), hibernation(TimerClock::duration::zero()),
+                        dormant(false), drowsy(false), spinLoops(0), yieldLoops(0),
+                        parked(false), evictions(0), dropped(0), blockedProducers(0), laned(false), lanesUsed(false),
+                        serial(laneSerials()++), lanesJoined(false), mboxLevels(new ActorQueue<ActorParcel>[Runnable::priorities - 1]),
+                        levelsPending(0), levelsPaused(0), laneTurn(0), burstSize(64),
+                        highPriRatio(0), highPriStreak(0), burst(0), job(this),
+                        scheduled(false), alarmed(false), started(false), finished(false),
+                        alarm(TimerClock::time_point::max()), wakeups(0), bursts(0), timerFires(0), typeMetrics(nullptr)
+        {
+            static_assert((Runnable::priorities >= 2) && (Runnable::priorities <= 64), "from 2 to 64 priority levels");
+        }
+
+        virtual ~ActorThread() // messages pending to be dispatched are discarded
+        {
+            if (anchor) anchor->release(); // no more messages through the direct links
+            clearLanes(true);
+        }
+
+        /* methods invoked on the active object (this default implementation can be "overrided") */
+
+        void onStart() {}
+        void onStop() {}
+
+        static const bool instrumented = false; // compile-time switch of the metrics() collection
+
+        static const unsigned priorities = 2; // mailboxes (strictly ordered: 0 = send() ... priorities - 1 = send<true>())
+
+        typedef ActorMessages<> messages; // accepted types (sending others fails to compile) or any if empty
+
+        typedef ActorMessages<> batched; // types whose consecutive messages are moved together into onMessages()
+
+        std::thread::id threadID() const { return id; } // (under an ActorScheduler the one of the latest burst)
+
+        const Settings& settings() const { return tuning; } // e.g. to create other objects alike
+
+        void pooledMessages(bool enable) // switch the Settings::pooled mode at any time (e.g. for benchmarking)
+        {
+            pooled.store(enable, std::memory_order_relaxed);
+        }
+
+        void lanedMessages(bool enable) // switch the Settings::lanes mode at any time (from the active object itself)
+        {
+            if (enable && (capacity > 0)) return; // (the bounded mailboxes rely on a single queue)
+            if (enable) lanesUsed.store(true, std::memory_order_relaxed); // from now on the lanes are drained as well
+            laned.store(enable, std::memory_order_relaxed); // (a producer keeps using its lane until it gets drained)
+        }
+
+        /* the active object may use this family of methods to perform the callbacks onto connected clients */
+
+        template <typename Any> inline static void publish(Any msg)
+        {
+            auto& link = directLink<Any>();
+            if (link) link(msg); // fast path (see getLink())
+            else
+            {
+                auto& bearer = callback<Any>();
+                if (bearer) bearer(msg); // if binded with getChannel() won't call a deleted peer
+            }
+        }
+
+        template <typename Any> static void broadcast(Any msg) // to every subscriber of the topic (single allocation)
+        {
+            if (!subscribers<Any>().empty()) broadcast<Any>(std::make_shared<const Any>(std::move(msg)));
+        }
+
+        template <typename Any> static void broadcast(const Shared<Any>& payload) // (shared, never copied nor moved)
+        {
+            auto& topic = subscribers<Any>();
+            for (auto link = topic.begin(); link != topic.end();)
+            {
+                Shared<Any> reference(payload); // (just a reference count increment)
+                if (!(*link)(reference) && link->expired()) link = topic.erase(link); // forget deleted subscribers
+                else ++link;
+            }
+        }
+
+        template <typename Any> static std::vector<ActorLink<Shared<Any>>>& subscribers() // topic storage (per type)
+        {
+            ActorThread* self = current();
+            if (self) return self->template local<std::vector<ActorLink<Shared<Any>>>>();
+            static thread_local std::vector<ActorLink<Shared<Any>>> bearer; // (invoked from a foreign thread)
+            return bearer;
+        }
+
+        template <typename Any> static Channel<Any>& callback() // callback storage (per active object and type)
+        {
+            ActorThread* self = current();
+            if (self) return self->template local<Channel<Any>>(); // beware that this callback moves the argument
+            static thread_local Channel<Any> bearer; // (invoked from a foreign thread)
+            return bearer;
+        }
+
+        template <typename Any> static ActorLink<Any>& directLink() // see connect(ActorLink<Any>)
+        {
+            ActorThread* self = current();
+            if (self) return self->template local<ActorLink<Any>>();
+            static thread_local ActorLink<Any> bearer;
+            return bearer;
+        }
+
+        /* request / reply: the answer is delivered through this mailbox and completes a continuation (no blocking) */
+
+        template <typename Reply> class Pending; // completion handle (attach its continuations before returning)
+
+        template <typename Reply, typename Request, typename Him>
+        Pending<Reply> ask(const std::shared_ptr<Him>& target, Request request) // target->onMessage(Request&) replies
+        {
+            auto pending = std::make_shared<ActorPending<Reply>>(weak_this);
+            auto peer = static_cast<ActorThread<Him>*>(target.get());
+            typedef typename ActorThread<Him>::template ActorRequest<Request> Parcelable;
+            if (!peer || !peer->template post<Parcelable, false>(std::move(request), std::shared_ptr<ActorAsk>(pending)))
+                pending->refused = true; // a timeout() will expire immediately
+            return Pending<Reply>(this, std::move(pending));
+        }
+
+        template <typename Reply> class Pending
+        {
+            public:
+
+                Pending& then(std::function<void(Reply&)> continuation) // invoked when the reply arrives
+                {
+                    if (!state->early) state->onReply = std::move(continuation);
+                    else if (continuation) // (already arrived: e.g. attached from a later message handler)
+                    {
+                        std::unique_ptr<Reply> reply(std::move(state->early));
+                        continuation(*reply);
+                    }
+                    return *this;
+                }
+
+                Pending& timeout(TimerClock::duration lapse, std::function<void()> expiration) // discards a late reply
+                {
+                    state->onTimeout = std::move(expiration);
+                    if (state->done) return *this;
+                    state->timed = true;
+                    typedef std::shared_ptr<ActorPending<Reply>> State;
+                    owner->timerStart(state, state->refused? TimerClock::duration::zero() : lapse,
+                                      Channel<const State>([](const State& expired) { expired->expire(); }));
+                    return *this;
+                }
+
+                bool pending() const { return !state->done; }
+
+                std::shared_ptr<ActorAsk> path() const { return state; } // to reply() through it (see expect())
+
+                void cancel() // neither the continuation nor the timeout will be invoked
+                {
+                    if (state->done) return;
+                    state->done = true;
+                    if (state->timed) owner->timerStop(state);
+                }
+
+#ifdef ACTORTHREAD_COROUTINES
+                class Awaiter // replaces the continuations (resumes with an empty reply if refused or expired)
+                {
+                    public:
+                        bool await_ready() const { return state->done || (state->refused && !state->timed); }
+                        void await_suspend(std::coroutine_handle<> coroutine)
+                        {
+                            state->onReply = [this, coroutine](Reply& reply)
+                            {
+                                result.emplace(std::move(reply));
+                                resumeFrame(coroutine);
+                            };
+                            state->onTimeout = [coroutine] { resumeFrame(coroutine); };
+                        }
+                        std::optional<Reply> await_resume()
+                        {
+                            if (state->early) // (arrived before the co_await)
+                            {
+                                result.emplace(std::move(*state->early));
+                                state->early.reset();
+                            }
+                            return std::move(result);
+                        }
+                    private:
+                        friend Pending;
+                        explicit Awaiter(const std::shared_ptr<ActorPending<Reply>>& pending) : state(pending) {}
+                        std::shared_ptr<ActorPending<Reply>> state;
+                        std::optional<Reply> result;
+                };
+
+                Awaiter operator co_await() const { return Awaiter(state); } // from a Coro (e.g. after a timeout())
+#endif
+
+            private:
+
+                friend ActorThread;
+                Pending(ActorThread* asker, std::shared_ptr<ActorPending<Reply>>&& pending)
+                  : owner(asker), state(std::move(pending)) {}
+
+                ActorThread* owner;
+                std::shared_ptr<ActorPending<Reply>> state;
+        };
+
+        template <typename Any> bool reply(Any msg) // answer the ask() request being processed
+        {
+            return reply(asker, std::move(msg)); // (false if none, of another reply type, or the asker is gone)
+        }
+
+        std::shared_ptr<ActorAsk> replyTo() const { return asker; } // to answer it later (e.g. after asking others)
+
+        template <typename Reply> Pending<Reply> expect() // completed by a reply() through its path() (from anyone)
+        {
+            return Pending<Reply>(this, std::make_shared<ActorPending<Reply>>(weak_this));
+        }
+
+        template <typename Any> static bool reply(const std::shared_ptr<ActorAsk>& to, Any msg) // from any thread
+        {
+            auto path = dynamic_cast<ActorAskFor<Any>*>(to.get());
+            return path && path->answer(std::move(msg));
+        }
+
+        /* timers facility for the active object (unlimited amount: one per each "payload" instance) */
+
+        enum class TimerCycle { Periodic, OneShot };
+
+        template <typename Any> void timerStart(const Any& payload, TimerClock::duration lapse,
+                                                Channel<const Any> event, TimerCycle cycle = TimerCycle::OneShot)
+        {
+            std::shared_ptr<ActorAlarm<Any>> timer;
+            auto& allTimersOfThatType = timerEvents<Any>(this);
+            auto pTimer = allTimersOfThatType.find(payload);
+            if (pTimer == allTimersOfThatType.end())
+            {
+                timer = std::make_shared<ActorAlarm<Any>>(std::move(event), payload);
+                allTimersOfThatType.emplace(timer->payload, timer);
+            }
+            else // reschedule and reprogram
+            {
+                timer = pTimer->second.lock();
+                timers.erase(timer);
+                timer->event = std::move(event);
+            }
+            timer->lapse = lapse;
+            timer->cycle = cycle;
+            timer->reset(false);
+            timers.insert(std::move(timer));
+        }
+
+        template <typename Any> void timerStart(const Any& payload, TimerClock::duration lapse, // invokes onTimer() methods
+                                                TimerCycle cycle = TimerCycle::OneShot)
+        {
+            Runnable* runnable = static_cast<Runnable*>(this); // safe (a dead 'this' will not dispatch timers)
+            timerStart(payload, lapse, Channel<const Any>([runnable](const Any& p) { runnable->onTimer(p); }), cycle);
+        }
+
+        template <typename Any> void timerReset(const Any& payload)
+        {
+            auto const& allTimersOfThatType = timerEvents<Any>(this);
+            auto pTimer = allTimersOfThatType.find(payload);
+            if (pTimer != allTimersOfThatType.end()) timerReschedule(pTimer->second.lock(), false);
+        }
+
+        template <typename Any> void timerStop(const Any& payload)
+        {
+            auto& allTimersOfThatType = timerEvents<Any>(this);
+            auto pTimer = allTimersOfThatType.find(payload);
+            if (pTimer != allTimersOfThatType.end())
+            {
+                auto timer = pTimer->second.lock();
+                timers.erase(timer);
+                allTimersOfThatType.erase(pTimer);
+                if (timer.use_count() > 1) timer->reset(false); // timer "touched" signaling to dispatcher
+            }
+        }
+
+#ifdef ACTORTHREAD_COROUTINES
+
+        /* member coroutines: started from the handlers and resumed on the object thread (frames recycled by it) */
+
+        class Coro // return type (it runs until its first suspension, e.g. 'Coro onMessage(Start&)' is a handler)
+        {
+            public:
+
+                struct promise_type : public ActorFrames::Frame
+                {
+                    template <typename ... Args> promise_type(Runnable& self, Args&...)
+                      : ActorFrames::Frame(static_cast<ActorThread&>(self).frames) {}
+
+                    template <typename ... Args> static void* operator new(std::size_t bytes, Runnable& self, Args&...)
+                    {
+                        return static_cast<ActorThread&>(self).frames.allocate(bytes);
+                    }
+
+                    static void operator delete(void* frame) { ActorFrames::release(frame); }
+
+                    Coro get_return_object()
+                    {
+                        handle = std::coroutine_handle<promise_type>::from_promise(*this);
+                        return Coro();
+                    }
+
+                    struct Ending // the frame is released at the end (unless an exception has to be rethrown first)
+                    {
+                        bool await_ready() const noexcept { return !frame->error; }
+                        void await_suspend(std::coroutine_handle<>) const noexcept { frame->failed(); }
+                        void await_resume() const noexcept {}
+                        ActorFrames::Frame* frame;
+                    };
+
+                    std::suspend_never initial_suspend() noexcept { return {}; }
+                    Ending final_suspend() noexcept { return Ending { this }; }
+                    void return_void() {}
+                    void unhandled_exception() { unhandled(); } // thrown as from a handler (see resumeFrame())
+                };
+        };
+
+        static void resumeFrame(std::coroutine_handle<> coroutine) // on the object thread
+        {
+            ActorThread* self = current();
+            if (!self) return coroutine.resume();
+            void* outer = self->frames.resuming(coroutine.address());
+            coroutine.resume();
+            self->frames.resuming(outer);
+            self->frames.rethrow(); // the exception which ended it (once its frame is released)
+        }
+
+        class Sleep // see sleepFor()
+        {
+            public:
+                bool await_ready() const { return false; }
+                void await_suspend(std::coroutine_handle<> coroutine)
+                {
+                    owner->timerStart(ActorWake { coroutine.address() }, lapse,
+                                      Channel<const ActorWake>([](const ActorWake& wake)
+                                      {
+                                          resumeFrame(std::coroutine_handle<>::from_address(wake.frame));
+                                      }));
+                }
+                void await_resume() const {}
+            private:
+                friend ActorThread;
+                Sleep(ActorThread* self, TimerClock::duration delay) : owner(self), lapse(delay) {}
+                ActorThread* owner;
+                TimerClock::duration lapse;
+        };
+
+        Sleep sleepFor(TimerClock::duration lapse) { return Sleep(this, lapse); } // co_await it (a one-shot timer)
+
+#endif
+
+        /* the active object may throw this object while processing a message */
+
+        struct DispatchRetry // the delivery will be retried later
+        {
+            DispatchRetry(TimerClock::duration waitToRetry = std::chrono::seconds(1)) : retryInterval(waitToRetry) {}
+            bool operator<(const DispatchRetry&) const { return false; } // enforce a single instance in the containers
+            TimerClock::duration retryInterval; // will be shortened on every incoming high priority message
+        };
+
+        // The following methods are exclusively intended to *interleave* the ActorThread dispatcher with another
+        // external dispatcher (e.g. Asio) which will actually be the master dispatcher having the thread control:
+        //
+        // - onWaitingEvents() must be used to request the external dispatcher to invoke handleActorEvents()
+        // - onWaitingTimer() must request the external dispatcher a delayed invocation of handleActorEvents()
+        // - onWaitingTimerCancel() must request the external dispatcher to cancel any delayed invocation
+        // - onStopping() must request the external dispatcher to end (not required a synchronous completion wait)
+
+        void acquireDispatcher() // request ActorThread to stop dispatching and invoke onDispatching()
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            externalDispatcher = true;
+            messageWaiter.notify_one();
+        }
+
+        void onDispatching() {} // run the external dispatcher from here (in case it exits, ActorThread resumes again)
+
+        void onWaitingEvents() {} // invoked from another threads (new messages coming)
+        void onWaitingTimer(TimerClock::duration); // invoked from dispatcher thread (there is only a single timer)
+        void onWaitingTimerCancel(); // invoked from dispatcher thread (will come even if the timer was not in use)
+        void onStopping() {} // invoked from another threads (mandatory handling: the object could be about to be deleted)
+
+        void handleActorEvents() // this must be invoked from the external dispatcher as specified above
+        {
+            auto status = eventsLoop();
+            if (status.first)
+                static_cast<Runnable*>(this)->onWaitingTimer(status.second);
+            else
+                static_cast<Runnable*>(this)->onWaitingTimerCancel();
+        }
+
+    private:
+
+        ActorThread& operator=(const ActorThread&) = delete;
+        ActorThread(const ActorThread&) = delete;
+
+        struct ActorIsolation // padding between the fields written by different threads (avoids false sharing)
+        {
+            ActorIsolation() {}
+            char line[128]; // (two cache lines: the adjacent one may be prefetched along)
+        };
+
+        template <typename Item> class ActorQueue // FIFO (based on the MPSC queue at https://github.com/mstump/queues)
+        {
+            public:
+
+                struct Linked { std::atomic<Item*> next; };
+
+                ActorQueue() : head(static_cast<Item*>(ActorPool::allocate(sizeof(Item), false))), // dummy placeholder
+                               pushed(0),
+                               lastFront(nullptr),
+                               prevFront(head.load(std::memory_order_relaxed)),
+                               taken(0), reported(0), stride(64),
+                               popped(0)
+                {
+                    prevFront->next.store(nullptr, std::memory_order_relaxed);
+                }
+
+                void clear() { while (front()) pop_front(); }
+
+                ~ActorQueue()
+                {
+                    clear();
+                    ActorPool::release(head.load(std::memory_order_relaxed)); // also suitable for a dummy instance
+                }
+
+                template <typename Linkable> std::size_t push_back(Linkable* item) // e.g. any type derived from 'Linked'
+                {
+                    return push_back(item, item, 1);
+                }
+
+                template <typename Linkable> std::size_t push_back(Linkable* first, Linkable* last, std::size_t amount)
+                {   // splices a chain of items already linked from 'first' to 'last'
+                    last->next.store(nullptr, std::memory_order_relaxed);
+                    Item* back = head.exchange(last, std::memory_order_acq_rel);
+                    back->next.store(first, std::memory_order_release);
+                    std::size_t before = pushed.fetch_add(amount, std::memory_order_seq_cst); // (see ActorThread::park())
+                    std::size_t out = popped.load(std::memory_order_seq_cst);
+                    return before > out? before - out : 0; // amount of previously queued items
+                }
+
+                inline Item* front() // returns nullptr if empty (must be always invoked just before pop_front())
+                {
+                    lastFront = prevFront->next.load(std::memory_order_acquire);
+                    if (!lastFront && (reported != taken)) // (the producers always know when it was drained)
+                        popped.store(reported = taken, std::memory_order_release);
+                    return lastFront;
+                }
+
+                void pop_front() // also destroys and ultimately deletes the item
+                {
+                    if (++taken - reported >= stride) popped.store(reported = taken, std::memory_order_release); // (seldom)
+                    lastFront->~Item(); // (atomic destructor is trivial) memory deletion is actually deferred one step behind
+                    ActorPool::release(prevFront); // delete the *previous* item memory no longer needed
+                    prevFront = lastFront;
+                }
+
+                void publishEvery(std::size_t pops) { stride = std::max(pops, std::size_t(1)); } // (before using it)
+
+                inline std::size_t size(bool consumer = false) const // approximate from other threads (see 'stride')
+                {
+                    std::size_t out = consumer? taken : popped.load(std::memory_order_acquire); // (never ahead of 'in')
+                    std::size_t in = pushed.load(std::memory_order_acquire);
+                    return in > out? in - out : 0; // (an item may be popped before being counted)
+                }
+
+                inline bool empty() const { return !size(); }
+
+            private:
+
+                ActorIsolation padFront;
+                std::atomic<Item*> head; // the stored objects hold the linked list pointers (single memory allocation)
+                std::atomic<std::size_t> pushed; // producers side (both written by the same atomic operations)
+                ActorIsolation padMiddle;
+                Item* lastFront; // consumer side
+                Item* prevFront;
+                std::size_t taken; // items popped
+                std::size_t reported; // the last published amount
+                std::size_t stride; // pops between publications (besides when found empty)
+                std::atomic<std::size_t> popped; // read by every producer (thus seldom written: see 'stride')
+                ActorIsolation padBack;
+        };
+
+    protected:
+
+        struct ActorParcel : public ActorQueue<ActorParcel>::Linked, public ActorStamp<Runnable::instrumented>,
+                             public ActorCode<(Runnable::messages::size > 0)>, public ActorRun<(Runnable::batched::size > 0)>
+        {
+            virtual ~ActorParcel() {}
+            virtual void deliverTo(Runnable* instance) = 0;
+        };
+
+    private:
+
+        class ActorRing // single producer FIFO of fixed-size slots in a chain of blocks (the mailbox lanes)
+        {
+            struct Block;
+
+            public:
+
+                enum { InlineBytes = 24, Slots = 256 }; // slots of 32 bytes (two per cache line) in blocks of 8 KB
+
+                struct Slot // either a small message stored inline or a parcel (sharing the order of the ring)
+                {
+                    union // zero for a parcel
+                    {
+                        void (*deliver)(Runnable*, void*); // invoked with 'payload'
+                        std::size_t code; // (instead when the registry of messages is declared)
+                    };
+                    union
+                    {
+                        ActorParcel* parcel;
+                        unsigned char payload[InlineBytes]; // (trivially destructible types only)
+                    };
+                };
+
+                ActorRing() : tail(new Block), tailIndex(0), written(0), pushed(0), head(tail), headIndex(0),
+                              taken(0), limit(0), reported(0), popped(0), spare(nullptr) {}
+
+                ~ActorRing()
+                {
+                    clear();
+                    while (head) // (a rewind() may have left unused blocks linked beyond the tail)
+                    {
+                        Block* next = head->next.load(std::memory_order_relaxed);
+                        delete head;
+                        head = next;
+                    }
+                    delete spare.load(std::memory_order_relaxed);
+                }
+
+                /* producer side */
+
+                Slot& back() // next slot to be written (and then advance())
+                {
+                    if (tailIndex == Slots)
+                    {
+                        Block* next = tail->next.load(std::memory_order_relaxed); // (unused after a rewind())
+                        if (!next)
+                        {
+                            next = spare.exchange(nullptr, std::memory_order_acquire);
+                            if (next) next->next.store(nullptr, std::memory_order_relaxed);
+                            else next = new Block;
+                            tail->next.store(next, std::memory_order_relaxed); // (visible along with its slots)
+                        }
+                        tail = next;
+                        tailIndex = 0;
+                    }
+                    return tail->slots[tailIndex];
+                }
+
+                void advance() { tailIndex++; written++; }
+
+                struct Cursor { Block* block; std::size_t index, written; };
+
+                Cursor cursor() const { return Cursor{ tail, tailIndex, written }; }
+
+                void rewind(const Cursor& mark) // forget the slots advanced (and not yet published) since the mark
+                {
+                    tail = mark.block;
+                    tailIndex = mark.index;
+                    written = mark.written;
+                }
+
+                std::size_t publish() // the advanced slots become visible (returns the amount of previously queued)
+                {
+                    std::size_t before = pushed.load(std::memory_order_relaxed);
+                    pushed.store(written, std::memory_order_seq_cst); // (see ActorThread::park())
+                    std::size_t out = popped.load(std::memory_order_seq_cst);
+                    return before > out? before - out : 0;
+                }
+
+                /* consumer side */
+
+                Slot* front() // returns nullptr if empty (must be always invoked just before pop_front())
+                {
+                    if ((taken == limit) && ((limit = pushed.load(std::memory_order_acquire)) == taken))
+                    {
+                        if (reported != taken) popped.store(reported = taken, std::memory_order_release);
+                        return nullptr; // (the producer always knows when the ring was drained)
+                    }
+                    if (headIndex == Slots)
+                    {
+                        Block* next = head->next.load(std::memory_order_relaxed);
+                        delete spare.exchange(head, std::memory_order_acq_rel); // (keeps one for the producer)
+                        head = next;
+                        headIndex = 0;
+                    }
+                    return &head->slots[headIndex];
+                }
+
+                Slot* peek(std::size_t ahead) // beyond front() without popping (nullptr if not yet there)
+                {
+                    if ((taken + ahead >= limit) && (taken + ahead >= (limit = pushed.load(std::memory_order_acquire))))
+                        return nullptr;
+                    Block* block = head;
+                    std::size_t index = headIndex + ahead;
+                    for (; index >= Slots; index -= Slots) block = block->next.load(std::memory_order_relaxed);
+                    return &block->slots[index];
+                }
+
+                void pop_front() // also destroys and deletes a parcel
+                {
+                    Slot& slot = head->slots[headIndex++];
+                    if (registered()? !slot.code : !slot.deliver)
+                    {
+                        slot.parcel->~ActorParcel();
+                        ActorPool::release(slot.parcel);
+                    }
+                    if ((++taken % 64) == 0) popped.store(reported = taken, std::memory_order_release); // (seldom)
+                }
+
+                void clear() { while (front()) pop_front(); }
+
+                bool empty() { return !front(); } // (consumer side)
+
+                std::size_t size(bool consumer = false) const // approximate from other threads (exact from the consumer)
+                {
+                    std::size_t out = consumer? taken : popped.load(std::memory_order_acquire);
+                    std::size_t in = pushed.load(std::memory_order_acquire);
+                    return in > out? in - out : 0;
+                }
+
+            private:
+
+                struct Block
+                {
+                    Block() : next(nullptr) {}
+                    Slot slots[Slots];
+                    std::atomic<Block*> next;
+                };
+
+                ActorIsolation padFront;
+                Block* tail; // producer side
+                std::size_t tailIndex;
+                std::size_t written;
+                std::atomic<std::size_t> pushed;
+                ActorIsolation padMiddle;
+                Block* head; // consumer side
+                std::size_t headIndex;
+                std::size_t taken;
+                std::size_t limit; // latest 'pushed' seen
+                std::size_t reported;
+                ActorIsolation padBack;
+                std::atomic<std::size_t> popped; // (stored every few messages and whenever the ring looks empty)
+                std::atomic<Block*> spare; // a block released by the consumer for reuse
+        };
+
+        template <typename> friend class ActorThread; // (ask() posts requests into other active objects)
+
+        template <typename Any> static void receive(Runnable* instance, Any& msg) // a single one
+        {
+            receive(instance, msg, std::integral_constant<bool, (ActorMessageCode<Any, typename Runnable::batched>::value > 0)>());
+        }
+
+        template <typename Any> static void receive(Runnable* instance, Any& msg, std::false_type)
+        {
+            instance->onMessage(msg);
+        }
+
+        template <typename Any> static void receive(Runnable* instance, Any& msg, std::true_type) // (see 'batched')
+        {
+            instance->onMessages(&msg, 1);
+        }
+
+        template <typename Any> struct ActorMessage : public ActorParcel // wraps any type
+        {
+            typedef Any Payload;
+            ActorMessage(Any&& msg) : message(std::move(msg)) {}
+            void deliverTo(Runnable* instance) { receive(instance, message); }
+            Any message;
+        };
+
+        template <typename Parcelable> struct ActorInlining : public std::false_type {}; // into a lane slot
+
+        template <typename Any> struct ActorInlining<ActorMessage<Any>>
+          : public std::integral_constant<bool, !Runnable::instrumented && std::is_trivially_destructible<Any>::value
+                                                && (sizeof(Any) <= ActorRing::InlineBytes)
+                                                && (alignof(Any) <= alignof(ActorParcel*))> {};
+
+        template <typename Any> static void deliverInline(Runnable* instance, void* payload)
+        {
+            receive(instance, *static_cast<Any*>(payload));
+        }
+
+        template <typename Any> struct ActorRequest : public ActorParcel // see ask()
+        {
+            typedef Any Payload;
+            ActorRequest(Any&& msg, std::shared_ptr<ActorAsk>&& path) : message(std::move(msg)), from(std::move(path)) {}
+            void deliverTo(Runnable* instance)
+            {
+                instance->asker = from; // (copied: the delivery could be retried)
+                try { receive(instance, message); } catch (...) { instance->asker.reset(); throw; }
+                instance->asker.reset();
+            }
+            Any message;
+            std::shared_ptr<ActorAsk> from;
+        };
+
+        template <typename Any, typename Key> struct ActorLatest : public ActorParcel // see sendLatest()
+        {
+            typedef Any Payload;
+            typedef std::map<Key, ActorLatest*> Index; // the undelivered ones (guarded by 'latestMtx')
+            ActorLatest(Any&& msg, const Key& id, ActorThread* target)
+              : message(std::move(msg)), key(id), owner(target), listed(true) {}
+            ~ActorLatest() // (also if discarded)
+            {
+                std::lock_guard<std::mutex> lock(owner->latestMtx);
+                unlist();
+            }
+            void deliverTo(Runnable* instance)
+            {
+                Any latest = take();
+                try { receive(instance, latest); }
+                catch (...) // (the delivery could be retried)
+                {
+                    std::lock_guard<std::mutex> lock(owner->latestMtx);
+                    message = std::move(latest);
+                    listed = owner->template latestIndex<Any, Key>().emplace(key, this).second; // unless already newer
+                    throw;
+                }
+            }
+            Any take() // the producers can't replace it anymore
+            {
+                std::lock_guard<std::mutex> lock(owner->latestMtx);
+                unlist();
+                return std::move(message);
+            }
+            void unlist()
+            {
+                if (listed) owner->template latestIndex<Any, Key>().erase(key);
+                listed = false;
+            }
+            Any message;
+            const Key key;
+            ActorThread* owner;
+            bool listed;
+        };
+
+        static constexpr bool registered() { return Runnable::messages::size > 0; } // see ActorMessages
+
+        template <typename Parcelable> struct ActorRegistry // code of the internal messages (virtual dispatch)
+        {
+            static const std::size_t code = 0;
+            static const bool accepted = true;
+        };
+
+        template <typename Any> struct ActorRegistry<ActorMessage<Any>>
+        {
+            static const std::size_t code = ActorMessageCode<Any, typename Runnable::messages>::value;
+            static const bool accepted = !registered() || code;
+        };
+
+        template <typename Any> struct ActorRegistry<ActorRequest<Any>> // (see ask())
+        {
+            static const std::size_t code = 0; // its delivery sets the reply path
+            static const bool accepted = !registered() || ActorMessageCode<Any, typename Runnable::messages>::value;
+        };
+
+        template <typename Any, typename Key> struct ActorRegistry<ActorLatest<Any, Key>> // (see sendLatest())
+        {
+            static const std::size_t code = 0; // its delivery updates the index of undelivered ones
+            static const bool accepted = !registered() || ActorMessageCode<Any, typename Runnable::messages>::value;
+        };
+
+        static constexpr bool batching() { return Runnable::batched::size > 0; } // see 'batched'
+
+        template <typename Parcelable> struct ActorBatching // (the internal messages are delivered one by one)
+        {
+            static const std::size_t run = 0;
+        };
+
+        template <typename Any> struct ActorBatching<ActorMessage<Any>>
+        {
+            static const std::size_t run = ActorMessageCode<Any, typename Runnable::batched>::value;
+        };
+
+        template <std::size_t Run, typename List> struct ActorRuns // delivery of runs by type (end of the batched ones)
+        {
+            static std::size_t inlined(const typename ActorRing::Slot&) { return 0; }
+            template <typename Source> static unsigned deliver(ActorThread*, std::size_t, Source&, unsigned) { return 0; }
+        };
+
+        template <std::size_t Run, typename Any, typename... Rest> struct ActorRuns<Run, ActorMessages<Any, Rest...>>
+        {
+            static std::size_t inlined(const typename ActorRing::Slot& slot) // run of a message stored in a lane slot
+            {
+                if (ActorInlining<ActorMessage<Any>>::value
+                    && (registered()? slot.code == ActorMessageCode<Any, typename Runnable::messages>::value
+                                    : slot.deliver == &deliverInline<Any>)) return Run;
+                return ActorRuns<Run + 1, ActorMessages<Rest...>>::inlined(slot);
+            }
+            template <typename Source>
+            static unsigned deliver(ActorThread* self, std::size_t run, Source& source, unsigned limit)
+            {
+                if (run == Run) return self->template deliverRun<Any>(source, run, limit);
+                return ActorRuns<Run + 1, ActorMessages<Rest...>>::deliver(self, run, source, limit);
+            }
+        };
+
+        template <std::size_t Code, typename List> struct ActorSwitch // dispatch by code (end of the registry)
+        {
+            static void parcel(Runnable*, std::size_t, ActorParcel*) {}
+            static void inlined(Runnable*, std::size_t, void*) {}
+        };
+
+        template <std::size_t Code, typename Any, typename... Rest> struct ActorSwitch<Code, ActorMessages<Any, Rest...>>
+        {   // comparisons against consecutive constants (inlined handlers: optimizers fold them into a jump table)
+            static void parcel(Runnable* instance, std::size_t code, ActorParcel* msg)
+            {
+                if (code == Code) receive(instance, static_cast<ActorMessage<Any>*>(msg)->message);
+                else ActorSwitch<Code + 1, ActorMessages<Rest...>>::parcel(instance, code, msg);
+            }
+            static void inlined(Runnable* instance, std::size_t code, void* payload)
+            {
+                if (code == Code) receive(instance, *static_cast<Any*>(payload));
+                else ActorSwitch<Code + 1, ActorMessages<Rest...>>::inlined(instance, code, payload);
+            }
+        };
+
+        template <typename Any> static void label(typename ActorRing::Slot& slot) // tag of an inlined message
+        {
+            if (registered()) slot.code = ActorMessageCode<Any, typename Runnable::messages>::value;
+            else slot.deliver = &deliverInline<Any>;
+        }
+
+        static void label(typename ActorRing::Slot& slot, ActorParcel* parcel)
+        {
+            if (registered()) slot.code = 0;
+            else slot.deliver = nullptr;
+            slot.parcel = parcel;
+        }
+
+        template <typename Reply> struct ActorPending : public ActorAskFor<Reply>,
+                                                        public std::enable_shared_from_this<ActorPending<Reply>>
+        {
+            ActorPending(const std::weak_ptr<Runnable>& caller)
+              : owner(caller), done(false), timed(false), refused(false) {}
+            bool answer(Reply&& reply)
+            {
+                auto alive = owner.lock();
+                auto self = this->shared_from_this();
+                return alive && alive->template post<ActorAnswer<Reply>, ActorThread::topPriority()>(std::move(self), std::move(reply));
+            }
+            void complete(Runnable* instance, Reply& reply) // on the asking thread
+            {
+                if (done) return; // (late, repeated, or cancelled)
+                done = true;
+                if (timed) instance->timerStop(this->shared_from_this());
+                if (onReply) onReply(reply);
+                else early.reset(new Reply(std::move(reply))); // kept until a continuation is attached
+            }
+            void expire()
+            {
+                if (done) return;
+                done = true;
+                if (onTimeout) onTimeout();
+            }
+            std::weak_ptr<Runnable> owner;
+            std::function<void(Reply&)> onReply;
+            std::function<void()> onTimeout;
+            std::unique_ptr<Reply> early; // arrived before then() (or co_await)
+            bool done;
+            bool timed;
+            bool refused;
+        };
+
+        template <typename Reply> struct ActorAnswer : public ActorParcel // high priority: never refused nor blocked
+        {
+            typedef Reply Payload;
+            ActorAnswer(std::shared_ptr<ActorPending<Reply>>&& to, Reply&& msg)
+              : pending(std::move(to)), reply(std::move(msg)) {}
+            void deliverTo(Runnable* instance) { pending->complete(instance, reply); }
+            std::shared_ptr<ActorPending<Reply>> pending;
+            Reply reply;
+        };
+
+        template <typename Any> struct ActorCallback : public ActorParcel
+        {
+            typedef Channel<Any> Payload;
+            ActorCallback(Channel<Any>&& msg) : message(std::move(msg)) {}
+            void deliverTo(Runnable*)
+            {
+                directLink<Any>() = ActorLink<Any>();
+                callback<Any>() = std::move(message);
+            }
+            Channel<Any> message;
+        };
+
+        template <typename Any> struct ActorLinker : public ActorParcel
+        {
+            typedef ActorLink<Any> Payload;
+            ActorLinker(ActorLink<Any>&& msg) : message(std::move(msg)) {}
+            void deliverTo(Runnable*)
+            {
+                callback<Any>() = message? Channel<Any>(message) : Channel<Any>(); // (also returned by callback())
+                directLink<Any>() = std::move(message);
+            }
+            ActorLink<Any> message;
+        };
+
+        template <typename Any> struct ActorSubscriber : public ActorParcel
+        {
+            typedef ActorLink<Shared<Any>> Payload;
+            ActorSubscriber(ActorLink<Shared<Any>>&& msg, bool add) : message(std::move(msg)), adding(add) {}
+            void deliverTo(Runnable*)
+            {
+                auto& topic = subscribers<Any>();
+                const ActorAnchor* target = message.anchor.get();
+                topic.erase(std::remove_if(topic.begin(), topic.end(), [target](const ActorLink<Shared<Any>>& link)
+                {
+                    return link.anchor.get() == target || link.expired(); // (no duplicates)
+                }), topic.end());
+                if (adding) topic.push_back(std::move(message));
+            }
+            ActorLink<Shared<Any>> message;
+            bool adding;
+        };
+
+        template <typename Any, bool HighPri> static bool postLinked(void* target, Any& data)
+        {
+            typedef typename std::remove_cv<Any>::type Message; // as send() would deduce it
+            auto self = static_cast<ActorThread*>(target);
+            return self->template post<ActorMessage<Message>, HighPri? topPriority() : 0>(Message(std::move(data)));
+        }
+
+        std::shared_ptr<ActorAnchor> anchored() // (created on demand)
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (!anchor) anchor = std::make_shared<ActorAnchor>(dispatching? this : nullptr);
+            return anchor;
+        }
+
+        struct ActorTimer : public ActorParcel, public std::enable_shared_from_this<ActorTimer>
+        {
+            virtual ~ActorTimer() {}
+            void reset(bool incremental)
+            {
+                if (!incremental) deadline = TimerClock::now();
+                deadline += lapse; // try keeping regular periodic intervals
+                if (incremental && (deadline < TimerClock::now())) deadline = TimerClock::now() + lapse; // fix lost events
+                shoot = false;
+            }
+            bool operator<(const ActorTimer& that) const // ordering in containers
+            {
+                if (deadline < that.deadline) return true;
+                else if (that.deadline < deadline) return false;
+                else return this < &that; // obviate the need for a multiset
+            }
+            TimerClock::duration lapse;
+            TimerCycle cycle;
+            TimerClock::time_point deadline;
+            bool shoot;
+            std::shared_ptr<ActorTimer> linked; // the timing wheel slots are intrusive lists (holding this reference)
+            ActorTimer** pprev;
+            ActorTimer* next;
+            uint64_t expiry; // tick
+            unsigned level;
+        };
+
+#ifdef ACTORTHREAD_COROUTINES
+        struct ActorWake // timer key of a sleeping coroutine (see sleepFor())
+        {
+            void* frame;
+            bool operator<(const ActorWake& other) const { return std::less<void*>()(frame, other.frame); }
+        };
+#endif
+
+        template <typename Any> struct ActorAlarm : public ActorTimer
+        {
+            ActorAlarm(Channel<const Any>&& fn, const Any& p) : event(std::move(fn)), payload(p) {}
+            void deliverTo(Runnable* instance)
+            {
+                this->shoot = true;
+                if (event) event(payload); // the invoked function could "touch" (shoot -> false) this very same timer
+                if (this->shoot)
+                {
+                    if (this->cycle == TimerCycle::OneShot)
+                        instance->timerStop(payload);
+                    else
+                        instance->timerReschedule(this->shared_from_this(), true);
+                }
+            }
+            Channel<const Any> event;
+            Any payload;
+        };
+
+        void timerReschedule(std::shared_ptr<ActorTimer>&& timer, bool incremental)
+        {
+            timers.erase(timer); // resetting will require a position change nearly 100% of times
+            timer->reset(incremental);
+            timers.insert(std::move(timer)); // emplaced in the new position
+        }
+
+        template <typename Any> static std::map<Any, std::weak_ptr<ActorAlarm<Any>>>& timerEvents(ActorThread* caller)
+        {
+            if (caller != current()) throw std::runtime_error("timer setup outside its owning thread");
+            return caller->template local<std::map<Any, std::weak_ptr<ActorAlarm<Any>>>>();
+        }
+
+        static ActorThread*& current() // the active object being dispatched by the calling thread
+        {
+            static thread_local ActorThread* self = nullptr;
+            return self;
+        }
+
+        template <typename Any> Any& local() // storage of any type bound to the active object (not to the thread)
+        {
+            static const std::size_t slot = localSlots()++;
+            if (slot >= locals.size()) locals.resize(slot + 1);
+            auto& storage = locals[slot];
+            if (!storage) storage = std::make_shared<Any>();
+            return *static_cast<Any*>(storage.get());
+        }
+
+        static std::atomic<std::size_t>& localSlots() { static std::atomic<std::size_t> slots(0); return slots; }
+
+        template <typename Any, typename Key> typename ActorLatest<Any, Key>::Index& latestIndex() // 'latestMtx' locked
+        {
+            typedef typename ActorLatest<Any, Key>::Index Index;
+            static const std::size_t slot = latestSlots()++;
+            if (slot >= latest.size()) latest.resize(slot + 1);
+            auto& storage = latest[slot];
+            if (!storage) storage = std::make_shared<Index>();
+            return *static_cast<Index*>(storage.get());
+        }
+
+        static std::atomic<std::size_t>& latestSlots() { static std::atomic<std::size_t> slots(0); return slots; }
+
+        static void actorThreadRecycler(Runnable* runnable)
+        {
+            if (runnable->stop(true)) delete runnable; // deletion is deferred when not possible (detaching the thread)
+        }
+
+        void spawn() // the dedicated thread (throws std::system_error if its attributes are refused)
+        {
+            auto cpus = tuning.cpus;
+            if (cpus.empty() && (tuning.numaNode >= 0))
+            {
+                cpus = ActorRunner::nodeCpus(tuning.numaNode);
+                if (cpus.empty()) throw std::system_error(ENODEV, std::system_category(), "ActorThread NUMA node");
+            }
+            static const int policies[] = { -1, // (ThreadPolicy order)
+#ifdef __linux__
+                SCHED_OTHER, SCHED_FIFO, SCHED_RR, SCHED_BATCH, SCHED_IDLE
+#else
+                -1, -1, -1, -1, -1
+#endif
+            };
+            runner.template start<&ActorThread::spawned>(this, cpus, tuning.stackSize,
+                                                         policies[static_cast<int>(tuning.policy)], tuning.priority,
+                                                         tuning.numaNode, tuning.name);
+        }
+
+        static void spawned(void* self) { static_cast<ActorThread*>(self)->dispatcher(); }
+
+        void configure(const Settings& settings) // invoked before the dispatcher starts
+        {
+            tuning = settings;
+            pooled.store(settings.pooled, std::memory_order_relaxed);
+            capacity = settings.capacity;
+            if (capacity > 0) mboxNormPri.publishEvery(1); // (the bounded mailbox admission requires its exact size)
+            overflow = settings.overflow;
+            scheduler = settings.scheduler;
+            if (!scheduler && !externalDispatcher) hibernation = settings.hibernation; // (own thread only)
+            if (settings.timerTick > TimerClock::duration::zero()) timers.useWheel(settings.timerTick);
+            spinLoops = (std::thread::hardware_concurrency() > 1)? settings.spinLoops : 0; // (useless on uniprocessors)
+            yieldLoops = settings.yieldLoops;
+            burstSize = std::max(settings.burst, 1u);
+            highPriRatio = settings.highPriRatio;
+            if (settings.lanes) lanedMessages(true);
+        }
+
+        bool stop(bool forced) try // return false if couldn't be properly stop
+        {
+            if (scheduler) return stopScheduled(forced);
+            std::unique_lock<std::mutex> ulock(mtx);
+            if (runner.current()) // self-stop?
+            {
+                if (forced && dispatching) // from delete? (shared_ptr circular reference just broken)
+                {
+                    if (runner.joinable())
+                    {
+                        runner.detach();
+                        detached = true;
+                    }
+                    dispatching = false;
+                    spaceWaiter.notify_all(); // release the producers blocked by a full mailbox
+                    auto links = anchor;
+                    ulock.unlock();
+                    if (links) links->release(); // (before the derived object destruction)
+                    static_cast<Runnable*>(this)->onStopping();
+                }
+                return false;
+            }
+            else // normal stop invoked from another thread (or if started from run())
+            {
+                if (!dispatching) return true; // was already stop
+                dispatching = false;
+                spaceWaiter.notify_all();
+                if (dormant) rouse(); // onStop() (and a deferred onStart()) still run on a thread of its own
+                bool fromCreate = runner.joinable();
+                if (fromCreate) messageWaiter.notify_one();
+                auto links = anchor;
+                ulock.unlock();
+                if (links) links->release(); // no more messages through the direct links
+                static_cast<Runnable*>(this)->onStopping();
+                if (!fromCreate) return true; // queues don't require and can't be cleared (potentially inside onMessage())
+                runner.join();
+                timers.clear();
+                mboxNormPri.clear(); // don't wait for this object deletion (the frozen queues
+                clearLevels(); // may store shared_ptr preventing other objects deletion)
+                clearLanes(false);
+                evictions = 0;
+                return true;
+            }
+        }
+        catch (...) { return false; }
+
+    protected:
+
+        template <typename Parcelable, unsigned Priority, typename... Args> bool post(Args&&... args) // on the calling thread
+        {
+            static_assert(ActorRegistry<Parcelable>::accepted, "message type not declared in the 'messages' registry");
+            if (!dispatching) return false; // don't store anything in a frozen queue
+            if (!Priority && (capacity > 0) && !admission(1)) return false; // (DropNewest counts it in droppedMessages())
+            if (!Priority && ActorInlining<Parcelable>::value && intoLane())
+                postInline<Parcelable>(ActorInlining<Parcelable>(), std::forward<Args>(args)...); // (no parcel)
+            else
+            {
+                Parcelable* parcel = make<Parcelable>(std::forward<Args>(args)...);
+                enqueue<Priority>(parcel, parcel, 1);
+            }
+            return true;
+        }
+
+        template <typename Parcelable, unsigned Priority, typename Any, typename Iterator>
+        std::size_t postBatch(Iterator first, Iterator last)
+        {
+            static_assert(ActorRegistry<Parcelable>::accepted, "message type not declared in the 'messages' registry");
+            auto amount = static_cast<std::size_t>(std::distance(first, last));
+            if (!amount || !dispatching) return 0;
+            if (!Priority && (capacity > 0) && !admission(amount)) return 0; // (DropNewest counts them as dropped)
+            if (!Priority && ActorInlining<Parcelable>::value && intoLane())
+            {
+                postInlineBatch<Any>(ActorInlining<Parcelable>(), first, last);
+                return amount;
+            }
+            ActorParcel* chain = nullptr;
+            ActorParcel* back = nullptr;
+            try
+            {
+                for (; first != last; ++first) // link the parcels privately (no atomic contention yet)
+                {
+                    ActorParcel* parcel = make<Parcelable>(Any(*first));
+                    if (back) back->next.store(parcel, std::memory_order_relaxed); else chain = parcel;
+                    back = parcel;
+                }
+            }
+            catch (...)
+            {
+                while (chain)
+                {
+                    ActorParcel* next = (chain == back)? nullptr : chain->next.load(std::memory_order_relaxed);
+                    chain->~ActorParcel();
+                    ActorPool::release(chain);
+                    chain = next;
+                }
+                throw;
+            }
+            enqueue<Priority>(chain, back, amount);
+            return amount;
+        }
+
+        template <unsigned Priority, typename Key, typename Any> bool postLatest(const Key& key, Any&& msg)
+        {
+            typedef ActorLatest<Any, Key> Parcelable;
+            static_assert(ActorRegistry<Parcelable>::accepted, "message type not declared in the 'messages' registry");
+            if (!dispatching) return false;
+            Parcelable* parcel = nullptr;
+            for (bool admitted = Priority || (capacity == 0); !parcel; admitted = true) // (see admission())
+            {
+                {
+                    std::lock_guard<std::mutex> lock(latestMtx); // (no other lock is taken while holding it)
+                    auto& index = latestIndex<Any, Key>();
+                    auto queued = index.find(key);
+                    if (queued != index.end())
+                    {
+                        queued->second->message = std::move(msg); // (no new message)
+                        return true;
+                    }
+                    if (!admitted && (overflow != Overflow::Block)) // once the key is known to be new (nor evicting
+                    {                                               // nor dropping anything on a replacement)
+                        if (!admission(1)) return false;
+                        admitted = true;
+                    }
+                    if (admitted)
+                    {
+                        parcel = make<Parcelable>(std::move(msg), key, this);
+                        index.emplace(key, parcel); // (can be replaced before being queued)
+                        continue;
+                    }
+                }
+                if (!admission(1)) return false; // Overflow::Block waits for room without the lock (it discards nothing)
+            }
+            enqueue<Priority>(parcel, parcel, 1);
+            return true;
+        }
+
+    private:
+
+        bool intoLane() const // Settings::lanes
+        {
+            if (current() == this) return false;
+            if (laned.load(std::memory_order_relaxed)) return true;
+            return lanesUsed.load(std::memory_order_relaxed) && laneBacklog(); // (switched off: keep the FIFO order)
+        }
+
+        template <typename Parcelable, typename... Args> void postInline(std::true_type, Args&&... args)
+        {
+            typedef typename Parcelable::Payload Any;
+            auto& ring = lane();
+            auto& slot = ring.back();
+            new (slot.payload) Any(std::forward<Args>(args)...);
+            label<Any>(slot);
+            ring.advance();
+            if (ring.publish() == 0) awaken(true);
+        }
+
+        template <typename Any, typename Iterator> void postInlineBatch(std::true_type, Iterator first, Iterator last)
+        {
+            auto& ring = lane();
+            auto mark = ring.cursor();
+            try
+            {
+                for (; first != last; ++first)
+                {
+                    auto& slot = ring.back();
+                    new (slot.payload) Any(*first);
+                    label<Any>(slot);
+                    ring.advance();
+                }
+            }
+            catch (...)
+            {
+                ring.rewind(mark); // (trivially destructible: nothing else to undo)
+                throw;
+            }
+            if (ring.publish() == 0) awaken(true);
+        }
+
+        template <typename Parcelable, typename... Args> void postInline(std::false_type, Args&&...) {} // (unused)
+        template <typename Any, typename Iterator> void postInlineBatch(std::false_type, Iterator, Iterator) {}
+
+        std::size_t normalMessages(bool owner = false) const // excluding those pending eviction
+        {
+            std::size_t queued = mboxNormPri.size(owner), evicting = evictions.load(std::memory_order_relaxed);
+            return queued > evicting? queued - evicting : 0;
+        }
+
+        template <typename Parcelable, typename... Args> Parcelable* make(Args&&... args)
+        {
+            void* memory = ActorPool::allocate(sizeof(Parcelable), pooled.load(std::memory_order_relaxed),
+                                               alignof(Parcelable));
+            Parcelable* parcel;
+            try { parcel = new (memory) Parcelable(std::forward<Args>(args)...); }
+            catch (...) { ActorPool::release(memory); throw; }
+            stamp<Parcelable>(*parcel);
+            encode<Parcelable>(*parcel);
+            classify<Parcelable>(*parcel);
+            return parcel;
+        }
+
+        template <typename Parcelable> static void stamp(ActorStamp<false>&) {}
+
+        template <typename Parcelable> static void stamp(ActorStamp<true>& parcel)
+        {
+            static const std::size_t kind = metricKinds()++;
+            parcel.posted = TimerClock::now();
+            parcel.type = &typeid(typename Parcelable::Payload);
+            parcel.kind = kind;
+        }
+
+        template <typename Parcelable> static void encode(ActorCode<false>&) {}
+
+        template <typename Parcelable> static void encode(ActorCode<true>& parcel)
+        {
+            parcel.code = ActorRegistry<Parcelable>::code;
+        }
+
+        template <typename Parcelable> static void classify(ActorRun<false>&) {}
+
+        template <typename Parcelable> static void classify(ActorRun<true>& parcel)
+        {
+            parcel.run = ActorBatching<Parcelable>::run;
+        }
+
+        static std::size_t runOf(ActorRun<false>&) { return 0; }
+        static std::size_t runOf(ActorRun<true>& parcel) { return parcel.run; }
+
+        static std::size_t runOf(typename ActorRing::Slot& slot)
+        {
+            if (registered()? !slot.code : !slot.deliver) return runOf(*slot.parcel);
+            return ActorRuns<1, typename Runnable::batched>::inlined(slot);
+        }
+
+        template <typename Any> static Any& payloadOf(ActorParcel* parcel)
+        {
+            return static_cast<ActorMessage<Any>*>(parcel)->message;
+        }
+
+        template <typename Any> static Any& payloadOf(typename ActorRing::Slot* slot)
+        {
+            if (registered()? !slot->code : !slot->deliver) return payloadOf<Any>(slot->parcel);
+            return *static_cast<Any*>(static_cast<void*>(slot->payload));
+        }
+
+        static ActorParcel* runStart(ActorQueue<ActorParcel>& mbox) { return mbox.front(); }
+        static ActorParcel* runNext(ActorQueue<ActorParcel>&, ActorParcel* item, std::size_t)
+        {
+            return item->next.load(std::memory_order_acquire); // (nullptr while being linked by a producer)
+        }
+        static typename ActorRing::Slot* runStart(ActorRing& ring) { return ring.front(); }
+        static typename ActorRing::Slot* runNext(ActorRing& ring, typename ActorRing::Slot*, std::size_t index)
+        {
+            return ring.peek(index);
+        }
+
+        void runPop(ActorQueue<ActorParcel>& mbox, TimerClock::time_point start, TimerClock::time_point end)
+        {
+            measure(*mbox.front(), start, end);
+            mbox.pop_front();
+        }
+
+        void runPop(ActorRing& ring, TimerClock::time_point start, TimerClock::time_point end)
+        {
+            auto slot = ring.front();
+            if (Runnable::instrumented) measure(*slot->parcel, start, end); // (never inlined)
+            ring.pop_front();
+        }
+
+        template <typename Any, typename Source> unsigned deliverRun(Source& source, std::size_t run, unsigned limit)
+        {   // consecutive messages of a batched type moved into a contiguous array (the lane slots are strided)
+            auto& batch = local<std::vector<Any>>(); // (its capacity is kept)
+            bool evicting = evictable(source);
+            std::size_t skipped = 0; // the oldest ones, discarded by the evictions requested meanwhile (DropOldest)
+            for (auto item = runStart(source); item && (batch.size() < limit) && (runOf(*item) == run);
+                 item = runNext(source, item, batch.size()))
+            {
+                batch.push_back(std::move(payloadOf<Any>(item)));
+                while (evicting && (skipped < batch.size()) && evicted()) skipped++;
+            }
+            auto count = batch.size(), handled = count - skipped;
+            auto start = Runnable::instrumented? TimerClock::now() : TimerClock::time_point();
+            try { if (handled) static_cast<Runnable*>(this)->onMessages(batch.data() + skipped, handled); }
+            catch (...) // put them back (the delivery could be retried)
+            {
+                auto item = runStart(source);
+                for (std::size_t i = 0; i < count; item = runNext(source, item, ++i))
+                    payloadOf<Any>(item) = std::move(batch[i]);
+                batch.clear();
+                evictions += skipped; // (to be discarded again)
+                throw;
+            }
+            batch.clear();
+            auto share = (Runnable::instrumented && handled)? // (of the handling time)
+                (TimerClock::now() - start) / static_cast<TimerClock::duration::rep>(handled) : TimerClock::duration::zero();
+            for (std::size_t i = 0; i < skipped; i++) // (neither measured)
+            {
+                source.front();
+                source.pop_front();
+            }
+            for (std::size_t i = 0; i < handled; i++) runPop(source, start, start + share);
+            std::size_t absorbed = 0; // evictions requested while handling them (they were the oldest ones)
+            while (evicting && (absorbed < handled) && evicted()) absorbed++;
+            dropped -= absorbed; // (delivered anyway)
+            return static_cast<unsigned>(count); // (up to 'limit')
+        }
+
+        bool evictable(ActorQueue<ActorParcel>& mbox) const { return &mbox == &mboxNormPri; } // see evicted()
+        bool evictable(ActorRing&) const { return false; } // (the lanes are unbounded)
+
+        unsigned runLimit() const { return (burst < burstSize)? burstSize - burst : 1; } // (messages in a run)
+
+        static std::atomic<std::size_t>& metricKinds() { static std::atomic<std::size_t> kinds(0); return kinds; }
+
+        void deliver(ActorParcel* msg, ActorStamp<false>&) { dispatch(msg, *msg); }
+
+        void deliver(ActorParcel* msg, ActorStamp<true>& mark) // measures the dwell and the handling times
+        {
+            auto start = TimerClock::now();
+            dispatch(msg, *msg);
+            measure(mark, start, TimerClock::now());
+        }
+
+        void measure(ActorStamp<false>&, TimerClock::time_point, TimerClock::time_point) {}
+
+        void measure(ActorStamp<true>& mark, TimerClock::time_point start, TimerClock::time_point end)
+        {
+            if (mark.kind >= typeIndex.size()) typeIndex.resize(mark.kind + 1);
+            auto& stats = typeIndex[mark.kind];
+            if (!stats) // first message of that type
+            {
+                stats.reset(new ActorTypeMetrics(mark.type->name()));
+                stats->next = typeMetrics.load(std::memory_order_relaxed);
+                typeMetrics.store(stats.get(), std::memory_order_release);
+            }
+            count(stats->delivered);
+            stats->dwell.record(static_cast<uint64_t>(std::chrono::nanoseconds(start - mark.posted).count()));
+            stats->handling.record(static_cast<uint64_t>(std::chrono::nanoseconds(end - start).count()));
+        }
+
+        void dispatch(ActorParcel* msg, ActorCode<false>&) { msg->deliverTo(static_cast<Runnable*>(this)); }
+
+        void dispatch(ActorParcel* msg, ActorCode<true>& tag)
+        {
+            if (tag.code) ActorSwitch<1, typename Runnable::messages>::parcel(static_cast<Runnable*>(this), tag.code, msg);
+            else msg->deliverTo(static_cast<Runnable*>(this));
+        }
+
+        static void count(std::atomic<uint64_t>& counter) // (single writer)
+        {
+            if (Runnable::instrumented) // (compiled out otherwise)
+                counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        }
+
+        struct ActorTypeMetrics
+        {
+            ActorTypeMetrics(const char* name) : type(name), delivered(0), next(nullptr) {}
+            const char* type;
+            std::atomic<uint64_t> delivered;
+            ActorHistogram dwell;
+            ActorHistogram handling;
+            ActorTypeMetrics* next; // readers list (immutable once published)
+        };
+
+        template <unsigned Priority> void enqueue(ActorParcel* first, ActorParcel* last, std::size_t amount)
+        {
+            if (!Priority && intoLane()) // the slots reference the parcels
+            {
+                auto& ring = lane();
+                for (std::size_t i = 0; i < amount; i++)
+                {
+                    auto& slot = ring.back();
+                    label(slot, first);
+                    ring.advance();
+                    if (first != last) first = first->next.load(std::memory_order_relaxed);
+                }
+                if (ring.publish() == 0) awaken(true);
+                return;
+            }
+            bool isIdle = mboxAt(Priority).push_back(first, last, amount) == 0;
+            if (Priority)
+            {
+                const uint64_t below = (uint64_t(1) << Priority) - 1; // (the lower levels pauses are lifted)
+                levelsPending.fetch_or(uint64_t(1) << Priority, std::memory_order_acq_rel); // (see drained())
+                if (levelsPaused.load(std::memory_order_relaxed) & below) // (usually not written)
+                    levelsPaused.fetch_and(~below, std::memory_order_relaxed);
+            }
+            if (isIdle) awaken(false); // if the consumer has pending messages (e.g. under high load) returns here
+        }
+
+        void awaken(bool fromLane) // the consumer looked idle (a lane alone can't tell whether the others are empty)
+        {
+            if (scheduler)
+            {
+                std::atomic_thread_fence(std::memory_order_seq_cst); // pairs with the fence in resume()
+                wake();
+                return;
+            }
+            if ((spinLoops || yieldLoops || fromLane) && !externalDispatcher) // the consumer could be still awake
+            {
+                std::atomic_thread_fence(std::memory_order_seq_cst); // pairs with the fence in park()
+                if (!parked.load(std::memory_order_relaxed)) return; // no mutex nor futex calls
+            }
+            std::lock_guard<std::mutex> lock(mtx); // under high load is only acquired in eventsLoop() (no effective lock)
+            if (dormant) return rouse(); // (throws std::system_error if a thread can't be spawned)
+            messageWaiter.notify_one(); // wakeup the consumer thread
+            static_cast<Runnable*>(this)->onWaitingEvents();
+        }
+
+        void wake() // M:N mode: get a worker to dispatch the events
+        {
+            if (!scheduled.exchange(true)) scheduler->submit(weak_job);
+        }
+
+        bool admission(std::size_t amount) // apply the bounded mailbox policy (true if the messages have to be queued)
+        {
+            std::size_t room = std::max(capacity, amount); // an oversized batch requires an empty mailbox
+            std::size_t queued = normalMessages();
+            if (queued + amount <= room) return true;
+            switch (overflow)
+            {
+                case Overflow::DropOldest:
+                    evictions += queued + amount - room; // the consumer will discard the oldest messages
+                    dropped += queued + amount - room;
+                    return true;
+                case Overflow::DropNewest:
+                    dropped += amount;
+                    return false;
+                case Overflow::Fail:
+                    return false;
+                case Overflow::Block:
+                    break;
+            }
+            if ((current() == this) || ActorScheduler::onWorker()) return false; // would wait for itself (or a worker)
+            std::unique_lock<std::mutex> ulock(mtx);
+            blockedProducers++;
+            spaceWaiter.wait(ulock, [this, amount, room] { return !dispatching || mboxNormPri.size() + amount <= room; });
+            blockedProducers--;
+            return dispatching;
+        }
+
+        bool evicted() // consumer side of Overflow::DropOldest
+        {
+            if (!evictions.load(std::memory_order_relaxed)) return false;
+            evictions.fetch_sub(1, std::memory_order_relaxed);
+            return true;
+        }
+
+        void unblockProducers() // consumer side of Overflow::Block (with hysteresis to save wakeups)
+        {
+            std::atomic_thread_fence(std::memory_order_seq_cst); // pairs with the blockedProducers increment
+            if (blockedProducers.load(std::memory_order_relaxed) && (mboxNormPri.size() <= capacity / 2))
+            {
+                std::lock_guard<std::mutex> lock(mtx);
+                spaceWaiter.notify_all();
+            }
+        }
+
+        struct ActorLane // mailbox of normal priority messages from a single producer thread (see Settings::lanes)
+        {
+            ActorLane() : closed(false) {}
+            ActorRing ring;
+            std::atomic<bool> closed; // the consumer was deleted
+        };
+
+        struct ActorLanes // producer side: the lanes of the calling thread (by consumer serial number)
+        {
+            ActorLanes() : serial(0), last(nullptr), sweep(16) {}
+            std::unordered_map<uint64_t, std::shared_ptr<ActorLane>> bySerial;
+            uint64_t serial; // latest consumer (repeated sends skip the lookup)
+            ActorLane* last;
+            std::size_t sweep; // amount of lanes which triggers forgetting the closed ones
+        };
+
+        static ActorLanes& threadLanes() { static thread_local ActorLanes own; return own; }
+
+        bool laneBacklog() const // messages of the calling thread still in its lane (seen empty once drained)
+        {
+            auto& own = threadLanes();
+            if (own.serial == serial) return own.last->ring.size() > 0;
+            auto found = own.bySerial.find(serial);
+            return (found != own.bySerial.end()) && (found->second->ring.size() > 0);
+        }
+
+        ActorRing& lane() // of the calling thread (registered on its first message to this object)
+        {
+            auto& own = threadLanes();
+            if (own.serial == serial) return own.last->ring;
+            auto found = own.bySerial.find(serial);
+            if (found == own.bySerial.end())
+            {
+                if (own.bySerial.size() >= own.sweep)
+                {
+                    for (auto it = own.bySerial.begin(); it != own.bySerial.end();)
+                        if (it->second->closed.load(std::memory_order_relaxed)) it = own.bySerial.erase(it);
+                        else ++it;
+                    own.sweep = std::max(std::size_t(16), own.bySerial.size() * 2);
+                }
+                auto fresh = std::make_shared<ActorLane>();
+                {
+                    std::lock_guard<std::mutex> lock(mtx);
+                    laneRegistry.push_back(fresh);
+                    lanesJoined.store(true, std::memory_order_relaxed); // (before the first push into the lane)
+                }
+                found = own.bySerial.emplace(serial, std::move(fresh)).first;
+            }
+            own.serial = serial;
+            own.last = found->second.get();
+            return own.last->ring;
+        }
+
+        void adoptLanes() // consumer side: take the lanes of new producers (forgetting those of the exited ones)
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            lanesJoined.store(false, std::memory_order_relaxed);
+            laneRegistry.erase(std::remove_if(laneRegistry.begin(), laneRegistry.end(),
+                                              [](const std::shared_ptr<ActorLane>& lane)
+            {
+                return (lane.use_count() == 1) && lane->ring.empty(); // (no producer thread will ever use it again)
+            }), laneRegistry.end());
+            lanes.clear();
+            for (auto& lane : laneRegistry) lanes.push_back(lane.get());
+            laneTurn = 0;
+        }
+
+        std::size_t normalTurn() // next lane with messages round-robin (lanes.size(): the shared mailbox, beyond: none)
+        {
+            for (std::size_t i = 0, n = lanes.size() + 1; i < n; i++, laneTurn = (laneTurn + 1) % n)
+                if ((laneTurn < lanes.size())? !lanes[laneTurn]->ring.empty() : !mboxNormPri.empty()) return laneTurn;
+            return lanes.size() + 1;
+        }
+
+        bool normalPending() // (consumer side)
+        {
+            if (!lanesUsed.load(std::memory_order_relaxed)) return !mboxNormPri.empty();
+            return (normalTurn() <= lanes.size()) || lanesJoined.load(std::memory_order_relaxed);
+        }
+
+        std::size_t laneMessages(bool owner = false) const // requires 'mtx' locked
+        {
+            std::size_t queued = 0;
+            for (auto& lane : laneRegistry) queued += lane->ring.size(owner);
+            return queued;
+        }
+
+        void clearLanes(bool closing) // once the dispatching is over (the parcels could hold references to objects)
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            for (auto& lane : laneRegistry)
+            {
+                lane->ring.clear();
+                if (closing) lane->closed.store(true, std::memory_order_relaxed);
+            }
+        }
+
+        static std::atomic<uint64_t>& laneSerials() { static std::atomic<uint64_t> serials(1); return serials; }
 
-        struct ActorParcel : public ActorQueue<ActorParcel>::Linked
+        int dispatcher() // runs on the wrapped thread
         {
-            virtual ~ActorParcel() {}
-            virtual void deliverTo(Runnable* instance) = 0;
-        };
+            id = std::this_thread::get_id();
+            current() = this;
+            Runnable* runnable = static_cast<Runnable*>(this);
+            if (!started) // (once, even if hibernated meanwhile)
+            {
+                started = true;
+                runnable->onStart();
+            }
+            for (;;)
+            {
+                burst = 0;
+                eventsLoop();
+                if (drowsy && hibernate()) return 0; // the thread no longer belongs to this object
+                if (!dispatching) break;
+                runnable->onDispatching();
+                externalDispatcher = false;
+            }
+            runnable->onStop();
+            dropFrames();
+            int code = exitCode;
+            current() = nullptr;
+            if (detached) delete runnable; // deferred self-deletion
+            return code;
+        }
 
-    private:
+        bool hibernate() // release the idle thread (see Settings::hibernation)
+        {
+            drowsy = false;
+            std::lock_guard<std::mutex> lock(mtx);
+            if (!dispatching || readyMessages() || !timers.empty()) return false;
+            dormant = true;
+            parked.store(true, std::memory_order_relaxed); // (the producers of the lanes must take the mutex)
+            runner.detach();
+            current() = nullptr;
+            return true; // the object can't be touched once unlocked (another thread may already be dispatching it)
+        }
 
-        template <typename Any> struct ActorMessage : public ActorParcel // wraps any type
+        void rouse() // requires 'mtx' locked: spawn a thread for the hibernated object
         {
-            ActorMessage(Any&& msg) : message(std::move(msg)) {}
-            void deliverTo(Runnable* instance) { instance->onMessage(message); }
-            Any message;
-        };
+            spawn();
+            dormant = false;
+            parked.store(false, std::memory_order_relaxed);
+        }
 
-        template <typename Any> struct ActorCallback : public ActorParcel
+        struct ActorJob : public ActorScheduler::Job // M:N mode binding
         {
-            ActorCallback(Channel<Any>&& msg) : message(std::move(msg)) {}
-            void deliverTo(Runnable*) { callback<Any>() = std::move(message); }
-            Channel<Any> message;
+            ActorJob(ActorThread* owner) : actor(owner) {}
+            void wake() // (alarm)
+            {
+                actor->alarmed = true; // just in case it is being dispatched right now
+                actor->wake();
+            }
+            void resume() { actor->resume(); }
+            ActorThread* actor;
         };
 
-        struct ActorTimer : public ActorParcel, public std::enable_shared_from_this<ActorTimer>
+        void resume() // M:N mode: runs a burst of events on a worker thread
         {
-            virtual ~ActorTimer() {}
-            void reset(bool incremental)
+            ActorThread* caller = current();
+            current() = this;
+            id = std::this_thread::get_id();
+            count(wakeups);
+            Runnable* runnable = static_cast<Runnable*>(this);
+            if (!started)
             {
-                if (!incremental) deadline = TimerClock::now();
-                deadline += lapse; // try keeping regular periodic intervals
-                if (incremental && (deadline < TimerClock::now())) deadline = TimerClock::now() + lapse; // fix lost events
-                shoot = false;
+                started = true;
+                runnable->onStart();
             }
-            bool operator<(const ActorTimer& that) const // ordering in containers
+            if (alarm != TimerClock::time_point::max() && (TimerClock::now() >= alarm))
+                alarm = TimerClock::time_point::max(); // already used
+            burst = 0;
+            for (unsigned fired = 0; dispatching && !timers.empty() && (fired < burstSize); fired++)
             {
-                if (deadline < that.deadline) return true;
-                else if (that.deadline < deadline) return false;
-                else return this < &that; // obviate the need for a multiset
+                auto timerEvent = timers.due(TimerClock::now()); // keeps it alive when self-removed from 'timers'
+                if (!timerEvent) break;
+                timerEvent->deliverTo(runnable);
+                count(timerFires);
             }
-            TimerClock::duration lapse;
-            TimerCycle cycle;
-            TimerClock::time_point deadline;
-            bool shoot;
-        };
+            while (dispatching && readyMessages())
+                if (consume(nextLevel())) break; // burst completed (let other objects run)
+            if (!dispatching) finish();
+            else
+            {
+                if (!timers.empty() && (timers.wakeup() < alarm))
+                {
+                    alarm = timers.wakeup();
+                    scheduler->wakeAt(weak_job, alarm);
+                }
+                scheduled.store(false); // from here on another worker could dispatch this object
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                if (readyLevels() || (!mboxNormPri.empty() && !paused(0)) || alarmed.exchange(false)) wake();
+                else
+                {
+                    std::unique_lock<std::mutex> ulock(mtx); // (the lanes can't be dispatched from here anymore)
+                    if (lanesUsed.load(std::memory_order_relaxed) && !paused(0) && laneMessages())
+                    {
+                        ulock.unlock();
+                        wake();
+                    }
+                    else idleWaiter.notify_all();
+                }
+            }
+            current() = caller;
+        }
 
-        template <typename Any> struct ActorAlarm : public ActorTimer
+        void dropFrames() // the suspended coroutines (destroyed while the object is still whole: their locals may use it)
         {
-            ActorAlarm(Channel<const Any>&& fn, const Any& p) : event(std::move(fn)), payload(p) {}
-            void deliverTo(Runnable* instance)
+#ifdef ACTORTHREAD_COROUTINES
+            frames.clear();
+#endif
+        }
+
+        void finish() // M:N mode: last dispatch
+        {
+            if (finished) return;
+            finished = true;
+            if (started) static_cast<Runnable*>(this)->onStop();
+            dropFrames();
+            timers.clear();
+            mboxNormPri.clear();
+            clearLevels();
+            clearLanes(false);
+            evictions = 0;
+            std::lock_guard<std::mutex> lock(mtx);
+            idleWaiter.notify_all();
+        }
+
+        bool stopScheduled(bool forced) // M:N mode: the stop is asynchronous unless forced
+        {
+            bool wasDispatching = dispatching.exchange(false);
+            if (wasDispatching)
             {
-                this->shoot = true;
-                if (event) event(payload); // the invoked function could "touch" (shoot -> false) this very same timer
-                if (this->shoot)
                 {
-                    if (this->cycle == TimerCycle::OneShot)
-                        instance->timerStop(payload);
-                    else
-                        instance->timerReschedule(this->shared_from_this(), true);
+                    std::lock_guard<std::mutex> lock(mtx);
+                    spaceWaiter.notify_all();
                 }
+                static_cast<Runnable*>(this)->onStopping();
             }
-            Channel<const Any> event;
-            Any payload;
+            if (forced) // deletion: no worker can be dispatching this object (they hold a reference while doing so)
+            {
+                ActorThread* caller = current();
+                current() = this;
+                finish();
+                current() = caller;
+            }
+            else if (wasDispatching && (current() != this)) // onStop() will be invoked from a worker
+            {
+                alarmed = true; // (a worker leaving resume() right now would otherwise ignore the wake())
+                wake();
+            }
+            return true;
+        }
+
+        struct ActorRetry // key of the DispatchRetry timer of each priority level
+        {
+            unsigned level;
+            bool operator<(const ActorRetry& other) const { return level < other.level; }
         };
 
-        void timerReschedule(std::shared_ptr<ActorTimer>&& timer, bool incremental)
+        void retryMbox(const ActorRetry& retry) { levelsPaused.fetch_and(~(uint64_t(1) << retry.level)); }
+
+        bool paused(unsigned level) const { return levelsPaused.load(std::memory_order_relaxed) & (uint64_t(1) << level); }
+
+        uint64_t readyLevels() const // bitmap of the priority levels (above 0) to be dispatched
         {
-            timers.erase(timer); // resetting will require a position change in the set nearly 100% of times
-            timer->reset(incremental);
-            timers.insert(std::move(timer)); // emplaced in the new position
+            return levelsPending.load(std::memory_order_acquire) & ~levelsPaused.load(std::memory_order_relaxed);
         }
 
-        template <typename Any> static std::map<Any, std::weak_ptr<ActorAlarm<Any>>>& timerEvents(ActorThread* caller)
+        bool readyMessages() { return readyLevels() || (!paused(0) && normalPending()); } // (consumer side)
+
+        unsigned nextLevel() // highest priority level with messages (0 includes none: see Settings::highPriRatio)
         {
-            if (caller->id != std::this_thread::get_id()) throw std::runtime_error("timer setup outside its owning thread");
-            static thread_local std::map<Any, std::weak_ptr<ActorAlarm<Any>>> info; // storage
-            return info;
+            uint64_t ready = readyLevels();
+            if (!ready) return 0;
+            if (highPriRatio && (highPriStreak >= highPriRatio) && !paused(0) && normalPending()) return 0;
+            return highestBit(ready);
         }
 
-        static void actorThreadRecycler(Runnable* runnable)
+        static unsigned highestBit(uint64_t bits) // (not zero)
         {
-            if (runnable->stop(true)) delete runnable; // deletion is deferred when not possible (detaching the thread)
+#if defined(__GNUC__)
+            return 63u - static_cast<unsigned>(__builtin_clzll(bits));
+#elif defined(_MSC_VER) && defined(_M_X64)
+            unsigned long index;
+            _BitScanReverse64(&index, bits);
+            return static_cast<unsigned>(index);
+#else
+            unsigned index = 0;
+            while (bits >>= 1) index++;
+            return index;
+#endif
         }
 
-        bool stop(bool forced) try // return false if couldn't be properly stop
+        static constexpr unsigned topPriority() { return Runnable::priorities - 1; } // (send<true>() and internal ones)
+
+        ActorQueue<ActorParcel>& mboxAt(unsigned level) { return level? mboxLevels[level - 1] : mboxNormPri; }
+        const ActorQueue<ActorParcel>& mboxAt(unsigned level) const { return level? mboxLevels[level - 1] : mboxNormPri; }
+
+        void drained(unsigned level) // the consumer found the mailbox empty
         {
-            std::unique_lock<std::mutex> ulock(mtx);
-            if (runner.get_id() == std::this_thread::get_id()) // self-stop?
+            const uint64_t bit = uint64_t(1) << level; // a producer either sets it afterwards or its push is seen here
+            levelsPending.fetch_and(~bit, std::memory_order_acq_rel);
+            if (!mboxAt(level).empty()) levelsPending.fetch_or(bit, std::memory_order_relaxed);
+        }
+
+        void clearLevels() // (but the normal one)
+        {
+            for (unsigned level = 1; level < Runnable::priorities; level++) mboxAt(level).clear();
+            levelsPending = 0;
+        }
+
+        bool burstCompleted(TimerClock::time_point deadline) // after every message (cut short when a timer is due)
+        {
+            if ((++burst < burstSize) && ((burst % 64) || (deadline == TimerClock::time_point::max())
+                                          || (TimerClock::now() < deadline))) return false;
+            burst = 0;
+            return true;
+        }
+
+        bool consume(unsigned level) // dispatch messages (returns true when the burst is completed)
+        {
+            auto deadline = timers.empty()? TimerClock::time_point::max() : timers.wakeup();
+            bool hasHigh = level > 0;
+            ActorRing* ring = nullptr;
+            if (!hasHigh && lanesUsed.load(std::memory_order_relaxed)) // (Settings::lanes)
             {
-                if (forced && dispatching) // from delete? (shared_ptr circular reference just broken)
+                if (lanesJoined.load(std::memory_order_relaxed)) adoptLanes();
+                std::size_t turn = normalTurn();
+                if (turn > lanes.size()) return false;
+                laneTurn = (turn + 1) % (lanes.size() + 1); // the next burst starts on the next lane
+                if (turn < lanes.size()) ring = &lanes[turn]->ring;
+            }
+            auto& mbox = mboxAt(level);
+            count(bursts);
+            try
+            {
+                if (ring) return consumeLane(*ring, deadline);
+                while (ActorParcel* msg = mbox.front())
                 {
-                    if (runner.joinable())
+                    std::size_t run = batching()? runOf(*msg) : 0;
+                    if (!hasHigh && evicted()) mbox.pop_front(); // (Overflow::DropOldest)
+                    else if (run) burst += ActorRuns<1, typename Runnable::batched>::deliver(this, run, mbox, runLimit()) - 1;
+                    else
                     {
-                        runner.detach();
-                        detached = true;
+                        deliver(msg, *msg);
+                        mbox.pop_front();
                     }
-                    dispatching = false;
-                    ulock.unlock();
-                    static_cast<Runnable*>(this)->onStopping();
+                    if (!hasHigh && (capacity > 0) && (overflow == Overflow::Block)) unblockProducers();
+                    bool yield = highPriRatio && yieldTurn(hasHigh);
+                    if (burstCompleted(deadline)) return true; // keep an eye on the timers
+                    if (yield) return false;
+                }
+                if (hasHigh)
+                {
+                    highPriStreak = 0;
+                    drained(level);
                 }
-                return false;
             }
-            else // normal stop invoked from another thread (or if started from run())
+            catch (const DispatchRetry& retry) // pauses this level (until then or a message of a higher one)
             {
-                if (!dispatching) return true; // was already stop
-                dispatching = false;
-                bool fromCreate = runner.joinable();
-                if (fromCreate) messageWaiter.notify_one();
-                ulock.unlock();
-                static_cast<Runnable*>(this)->onStopping();
-                if (!fromCreate) return true; // queues don't require and can't be cleared (potentially inside onMessage())
-                runner.join();
-                timers.clear();
-                mboxNormPri.clear(); // don't wait for this object deletion (the frozen queues
-                mboxHighPri.clear(); // may store shared_ptr preventing other objects deletion)
-                return true;
+                auto event = Channel<const ActorRetry>([this](const ActorRetry& ar) { retryMbox(ar); });
+                timerStart(ActorRetry { level }, retry.retryInterval, std::move(event));
+                levelsPaused.fetch_or(uint64_t(1) << level);
             }
+            return false;
         }
-        catch (...) { return false; }
-
-    protected:
 
-        template <typename Parcelable, bool HighPri, typename Any> void post(Any&& msg) // runs on the calling thread
+        bool yieldTurn(bool hasHigh) // Settings::highPriRatio
         {
-            auto& mbox = HighPri? mboxHighPri : mboxNormPri;
-            if (!dispatching) return; // don't store anything in a frozen queue
-            bool isIdle = mbox.push_back(new Parcelable(std::forward<Any>(msg))) == 0;
-            if (HighPri) mboxPaused = false;
-            if (!isIdle) return; // if the consumer has pending messages (e.g. under high load) this method returns here
-            std::lock_guard<std::mutex> lock(mtx); // under high load is only acquired in eventsLoop() (no effective lock)
-            messageWaiter.notify_one(); // wakeup the consumer thread
-            static_cast<Runnable*>(this)->onWaitingEvents();
+            if (!hasHigh)
+            {
+                highPriStreak = 0;
+                return readyLevels() != 0;
+            }
+            if (++highPriStreak < highPriRatio) return false;
+            highPriStreak = highPriRatio;
+            return !paused(0) && normalPending();
         }
 
-    private:
-
-        int dispatcher() // runs on the wrapped thread
+        bool consumeLane(ActorRing& ring, TimerClock::time_point deadline) // (returns true when the burst is completed)
         {
-            id = std::this_thread::get_id();
             Runnable* runnable = static_cast<Runnable*>(this);
-            runnable->onStart();
-            for (;;)
+            while (typename ActorRing::Slot* slot = ring.front())
             {
-                burst = 0;
-                eventsLoop();
-                if (!dispatching) break;
-                runnable->onDispatching();
-                externalDispatcher = false;
+                if (std::size_t run = batching()? runOf(*slot) : 0)
+                    burst += ActorRuns<1, typename Runnable::batched>::deliver(this, run, ring, runLimit()) - 1;
+                else
+                {
+                    if (registered() && slot->code) // no parcel nor virtual call
+                        ActorSwitch<1, typename Runnable::messages>::inlined(runnable, slot->code, slot->payload);
+                    else if (!registered() && slot->deliver) slot->deliver(runnable, slot->payload);
+                    else deliver(slot->parcel, *slot->parcel);
+                    ring.pop_front();
+                }
+                bool yield = highPriRatio && yieldTurn(false);
+                if (burstCompleted(deadline)) return true;
+                if (yield) return false;
             }
-            runnable->onStop();
-            int code = exitCode;
-            if (detached) delete runnable; // deferred self-deletion
-            return code;
+            return false;
         }
 
-        void retryMbox(const DispatchRetry&) { mboxPaused = false; }
-
         std::pair<bool, TimerClock::duration> eventsLoop()
         {
             bool haveTimerLapse = false;
@@ -477,60 +3257,48 @@ template <typename Runnable> class ActorThread
             bool mustDispatch = true;
             while (dispatching && mustDispatch)
             {
-                bool hasHigh = !mboxHighPri.empty();
-                bool hasNorm = !mboxNormPri.empty();
-
-                if (!mboxPaused && (hasHigh || hasNorm)) // consume the messages queue
+                if (readyMessages() && consume(nextLevel()) && externalDispatcher)
                 {
-                    auto& mbox = hasHigh? mboxHighPri : mboxNormPri;
-                    try
-                    {
-                        while (ActorParcel* msg = mbox.front())
-                        {
-                            msg->deliverTo(runnable);
-                            mbox.pop_front();
-                            if ((++burst % 64) == 0)
-                            {
-                                if (externalDispatcher) // do not monopolize the CPU on this dispatcher
-                                {
-                                    runnable->onWaitingEvents(); // queue a resume request
-                                    mustDispatch = false;
-                                }
-                                break; // keep an eye on the timers
-                            }
-                        }
-                    }
-                    catch (const DispatchRetry& retry)
-                    {
-                        auto event = Channel<const DispatchRetry>([this](const DispatchRetry& dr) { retryMbox(dr); });
-                        timerStart(retry, retry.retryInterval, std::move(event));
-                        mboxPaused = true;
-                    }
+                    runnable->onWaitingEvents(); // do not monopolize the CPU on this dispatcher (queue a resume request)
+                    mustDispatch = false;
                 }
 
-                auto firstTimer = timers.cbegin();
-                if (firstTimer == timers.cend())
+                if (timers.empty())
                 {
+                    if (spin(TimerClock::time_point::max())) continue;
                     std::unique_lock<std::mutex> ulock(mtx); // lock required *here* to overcome the sleeping barber problem
-                    if (mboxNormPri.empty() && mboxHighPri.empty() && dispatching)
+                    park(true);
+                    if (!readyMessages() && dispatching)
                     {
                         idleWaiter.notify_all();
                         if (externalDispatcher) break;
-                        messageWaiter.wait(ulock); // wait for incoming messages
+                        if (hibernation == TimerClock::duration::zero())
+                            messageWaiter.wait(ulock); // wait for incoming messages
+                        else if ((messageWaiter.wait_for(ulock, hibernation) == std::cv_status::timeout)
+                                 && !readyMessages())
+                        {
+                            drowsy = true; // (the dispatcher will hibernate)
+                            break;
+                        }
+                        count(wakeups);
                     }
+                    park(false);
                 }
                 else
                 {
-                    auto wakeup = (*firstTimer)->deadline;
-                    if (TimerClock::now() >= wakeup)
+                    auto timerEvent = timers.due(TimerClock::now()); // keeps it alive when self-removed from 'timers'
+                    if (timerEvent)
                     {
-                        auto timerEvent = *firstTimer; // this shared_ptr keeps it alive when self-removed from the set
                         timerEvent->deliverTo(runnable); // here it could be self-removed (timerStop)
+                        count(timerFires);
                     }
                     else // the other timers are scheduled even further
                     {
+                        auto wakeup = timers.wakeup();
+                        if (spin(wakeup)) continue;
                         std::unique_lock<std::mutex> ulock(mtx); // prevent sleeping barber problem
-                        if (dispatching && mboxHighPri.empty() && (mboxNormPri.empty() || mboxPaused))
+                        park(true);
+                        if (dispatching && !readyMessages())
                         {
                             idleWaiter.notify_all();
                             if (externalDispatcher)
@@ -540,13 +3308,49 @@ template <typename Runnable> class ActorThread
                                 break;
                             }
                             messageWaiter.wait_until(ulock, wakeup); // wait until first timer or for incoming messages
+                            count(wakeups);
                         }
+                        park(false);
                     }
                 }
             }
             return std::make_pair(haveTimerLapse, timerLapse);
         }
 
+        bool spin(TimerClock::time_point wakeup) // idle strategy before parking (returns true if there are events)
+        {
+            if (externalDispatcher) return false;
+            for (unsigned i = 0, loops = spinLoops + yieldLoops; i < loops; i++)
+            {
+                if (!dispatching || readyMessages()) return true;
+                if ((i % 64 == 0) && (wakeup != TimerClock::time_point::max()) && (TimerClock::now() >= wakeup))
+                    return true;
+                if (i < spinLoops) cpuRelax();
+                else std::this_thread::yield();
+            }
+            return false;
+        }
+
+        void park(bool sleeping) // requires 'mtx' locked (the producers only notify a parked consumer if spinning or laned)
+        {
+            if (spinLoops || yieldLoops || lanesUsed.load(std::memory_order_relaxed))
+                parked.store(sleeping, std::memory_order_relaxed);
+            if (sleeping) std::atomic_thread_fence(std::memory_order_seq_cst); // the mailboxes are checked afterwards
+        }   // (pairs with the push of an item: a producer either sees the consumer idle or the consumer sees the item)
+
+        static void cpuRelax() // busy-wait hint (saves power and avoids a pipeline flush when leaving the loop)
+        {
+#if defined(__i386__) || defined(__x86_64__)
+            __builtin_ia32_pause();
+#elif defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+            _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+            __asm__ __volatile__("yield");
+#else
+            std::atomic_signal_fence(std::memory_order_seq_cst);
+#endif
+        }
+
         template <typename Key> struct ActorPointedKeyComparator
         {
             inline bool operator()(const std::shared_ptr<Key>& key1, const std::shared_ptr<Key>& key2) const
@@ -555,21 +3359,240 @@ template <typename Runnable> class ActorThread
             }
         };
 
+        class ActorTimers // ordered by deadline (default) or placed in a hierarchical timing wheel (O(1) operations)
+        {
+            public:
+
+                ActorTimers() : tick(TimerClock::duration::zero()), current(0), size(0), counts(), slots(), expired() {}
+                ~ActorTimers() { clear(); } // (breaks the 'linked' self references)
+
+                void useWheel(TimerClock::duration resolution) // while empty
+                {
+                    tick = resolution;
+                    origin = TimerClock::now();
+                }
+
+                bool empty() const { return isWheel()? !size : ordered.empty(); }
+
+                void insert(std::shared_ptr<ActorTimer>&& timer)
+                {
+                    if (!isWheel()) ordered.insert(std::move(timer));
+                    else
+                    {
+                        ActorTimer* node = timer.get();
+                        node->linked = std::move(timer);
+                        node->expiry = ticksUntil(node->deadline, true);
+                        place(node);
+                        size++;
+                    }
+                }
+
+                void erase(const std::shared_ptr<ActorTimer>& timer)
+                {
+                    if (!isWheel()) ordered.erase(timer);
+                    else if (timer->linked) // (not yet expired)
+                    {
+                        unlink(timer.get());
+                        timer->linked.reset(); // the caller still holds a reference
+                        size--;
+                    }
+                }
+
+                void clear()
+                {
+                    ordered.clear();
+                    for (unsigned level = 0; level <= Levels; level++)
+                        for (unsigned slot = 0; slot < Slots; slot++)
+                            while (ActorTimer* node = (level < Levels)? slots[level][slot] : expired)
+                            {
+                                unlink(node);
+                                node->linked.reset();
+                            }
+                    size = 0;
+                }
+
+                TimerClock::time_point wakeup() const // earliest deadline (or cascade of the wheel) while not empty()
+                {
+                    if (!isWheel()) return (*ordered.cbegin())->deadline;
+                    if (expired) return origin;
+                    uint64_t earliest = std::numeric_limits<uint64_t>::max();
+                    for (unsigned level = 0; level < Levels; level++)
+                    {
+                        if (!counts[level]) continue;
+                        uint64_t base = current >> (Bits * level);
+                        for (uint64_t i = 1; i <= Slots; i++)
+                            if (slots[level][(base + i) & (Slots - 1)])
+                            {
+                                earliest = std::min(earliest, (base + i) << (Bits * level));
+                                break;
+                            }
+                    }
+                    return origin + tick * static_cast<TimerClock::rep>(earliest);
+                }
+
+                std::shared_ptr<ActorTimer> due(TimerClock::time_point now) // the timer still belongs to the set
+                {
+                    if (!isWheel())
+                    {
+                        if (ordered.empty() || (now < (*ordered.cbegin())->deadline)) return nullptr;
+                        return *ordered.cbegin();
+                    }
+                    advance(ticksUntil(now, false));
+                    if (!expired) return nullptr;
+                    ActorTimer* node = expired; // extracted from the wheel (as if erased)
+                    unlink(node);
+                    size--;
+                    return std::move(node->linked);
+                }
+
+            private:
+
+                static const unsigned Levels = 4, Bits = 8, Slots = 1 << Bits; // 2^32 ticks range
+
+                bool isWheel() const { return tick > TimerClock::duration::zero(); }
+
+                uint64_t ticksUntil(TimerClock::time_point when, bool roundUp) const // (deadlines never fire early)
+                {
+                    if (when <= origin) return 0;
+                    auto elapsed = (when - origin).count();
+                    return static_cast<uint64_t>((elapsed + (roundUp? tick.count() - 1 : 0)) / tick.count());
+                }
+
+                void place(ActorTimer* node)
+                {
+                    ActorTimer** head = &expired;
+                    node->level = Levels;
+                    if (node->expiry > current)
+                    {
+                        uint64_t delta = node->expiry - current;
+                        unsigned level = 0;
+                        while ((level < Levels - 1) && (delta >> (Bits * (level + 1)))) level++;
+                        uint64_t target = node->expiry;
+                        if (delta >> (Bits * Levels)) // too far: will be cascaded again
+                            target = current + (uint64_t(1) << (Bits * Levels)) - 1;
+                        head = &slots[level][(target >> (Bits * level)) & (Slots - 1)];
+                        node->level = level;
+                        counts[level]++;
+                    }
+                    node->pprev = head;
+                    node->next = *head;
+                    if (*head) (*head)->pprev = &node->next;
+                    *head = node;
+                }
+
+                void unlink(ActorTimer* node)
+                {
+                    if (node->level < Levels) counts[node->level]--;
+                    *node->pprev = node->next;
+                    if (node->next) node->next->pprev = node->pprev;
+                }
+
+                void advance(uint64_t now) // move the expired timers into the 'expired' list
+                {
+                    while (current < now)
+                    {
+                        unsigned idle = 0; // lowest levels without timers
+                        while ((idle < Levels) && !counts[idle]) idle++;
+                        if (idle == Levels)
+                        {
+                            current = now;
+                            break;
+                        }
+                        uint64_t skip = current | ((uint64_t(1) << (Bits * idle)) - 1); // nothing to do until there
+                        if (skip >= now)
+                        {
+                            current = now;
+                            break;
+                        }
+                        current = skip + 1;
+                        unsigned top = 0; // highest level to cascade
+                        while ((top < Levels - 1) && !(current & ((uint64_t(1) << (Bits * (top + 1))) - 1))) top++;
+                        for (unsigned level = top; level > 0; level--) // cascade from the upper levels
+                            relocate(slots[level][(current >> (Bits * level)) & (Slots - 1)]);
+                        relocate(slots[0][current & (Slots - 1)]); // expired
+                    }
+                }
+
+                void relocate(ActorTimer*& head)
+                {
+                    while (ActorTimer* node = head)
+                    {
+                        unlink(node);
+                        place(node);
+                    }
+                }
+
+                TimerClock::duration tick;
+                TimerClock::time_point origin;
+                uint64_t current; // ticks since 'origin' already processed
+                std::size_t size;
+                std::size_t counts[Levels];
+                ActorTimer* slots[Levels][Slots];
+                ActorTimer* expired;
+                std::set<std::shared_ptr<ActorTimer>, ActorPointedKeyComparator<ActorTimer>> ordered;
+        };
+
         std::atomic<bool> dispatching;
         std::atomic<bool> externalDispatcher;
         std::atomic<bool> detached;
         mutable std::weak_ptr<Runnable> weak_this;
-        std::thread runner;
+        ActorRunner runner;
         std::thread::id id;
         int exitCode;
+        std::atomic<bool> pooled;
         mutable std::mutex mtx;
         std::condition_variable messageWaiter;
         std::condition_variable idleWaiter;
-        ActorQueue<ActorParcel> mboxNormPri;
-        ActorQueue<ActorParcel> mboxHighPri;
-        std::atomic<bool> mboxPaused;
-        uint16_t burst;
-        std::set<std::shared_ptr<ActorTimer>, ActorPointedKeyComparator<ActorTimer>> timers; // ordered by deadline
+        std::condition_variable spaceWaiter;
+        std::size_t capacity;
+        Overflow overflow;
+        std::shared_ptr<ActorScheduler> scheduler; // M:N mode
+        TimerClock::duration hibernation; // see Settings::hibernation
+        bool dormant; // hibernated: without a thread (guarded by 'mtx')
+        bool drowsy; // idle for 'hibernation' (dispatcher side)
+        unsigned spinLoops;
+        unsigned yieldLoops;
+        std::atomic<bool> parked; // sleeping on 'messageWaiter' (only tracked with an spinning idle strategy)
+        std::atomic<std::size_t> evictions;
+        std::atomic<std::size_t> dropped;
+        std::atomic<unsigned> blockedProducers;
+        std::atomic<bool> laned; // see Settings::lanes
+        std::atomic<bool> lanesUsed; // (ever)
+        const uint64_t serial; // identifies the lanes of this object in the producer threads
+        std::atomic<bool> lanesJoined; // by new producers (the fields above are mostly read by the producers)
+        std::vector<std::shared_ptr<ActorLane>> laneRegistry; // guarded by 'mtx'
+        std::mutex latestMtx; // see sendLatest() (the parcels being destroyed use it: declared before the mailboxes)
+        std::vector<std::shared_ptr<void>> latest; // index of the undelivered ones for each message and key types
+        ActorQueue<ActorParcel> mboxNormPri; // (each one isolated in its own cache lines)
+        std::unique_ptr<ActorQueue<ActorParcel>[]> mboxLevels; // the priority levels above 0 (see 'priorities')
+        std::atomic<uint64_t> levelsPending; // bitmap of the non empty ones (the dispatcher picks the next in O(1))
+        std::atomic<uint64_t> levelsPaused; // bitmap of the DispatchRetry (from level 0 upwards)
+        std::vector<ActorLane*> lanes; // consumer side: the adopted ones (drained round-robin along with 'mboxNormPri')
+        std::size_t laneTurn; // round-robin
+        unsigned burstSize; // see Settings::burst
+        unsigned highPriRatio;
+        unsigned highPriStreak; // high priority messages dispatched since the last normal one
+        unsigned burst; // messages dispatched in the current round
+        ActorTimers timers;
+        std::vector<std::shared_ptr<void>> locals; // see local()
+#ifdef ACTORTHREAD_COROUTINES
+        ActorFrames frames; // see Coro (the suspended ones are destroyed once stopped: see dropFrames())
+#endif
+        std::shared_ptr<ActorAsk> asker; // while processing a request (see reply())
+        std::shared_ptr<ActorAnchor> anchor; // see getLink()
+        Settings tuning;
+        ActorJob job;
+        std::weak_ptr<ActorScheduler::Job> weak_job;
+        std::atomic<bool> scheduled;
+        std::atomic<bool> alarmed;
+        bool started;
+        bool finished;
+        TimerClock::time_point alarm; // wakeup requested to the scheduler
+        std::atomic<uint64_t> wakeups; // metrics (only collected when instrumented)
+        std::atomic<uint64_t> bursts;
+        std::atomic<uint64_t> timerFires;
+        std::vector<std::unique_ptr<ActorTypeMetrics>> typeIndex; // by ActorStamp::kind (accessed by the dispatcher)
+        std::atomic<ActorTypeMetrics*> typeMetrics; // (the same, readable from any thread)
 };
 
 #endif /* ACTORTHREAD_HPP */